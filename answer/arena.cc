@@ -0,0 +1,115 @@
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <new>
+
+using namespace std;
+
+template <class T>
+void destroy_object(void *p){
+	static_cast<T *>(p)->~T();
+}
+
+// arena - owns the AST nodes of one compilation. Nodes are bump allocated
+// out of large chunks and released all at once, so building and tearing
+// down a tree costs a handful of heap calls instead of one per node. With
+// set_bump(false) every node gets its own heap block, for comparison.
+class arena{
+
+public:
+	arena() : next(NULL), limit(NULL), bump(true), objects(0), bytes(0), allocations(0) {}
+	~arena(){ release(); }
+
+	// destroy, if not NULL, runs on the object when the arena is released
+	void *allocate(size_t size, void (*destroy)(void *)){
+		size = (size + align - 1) & ~(align - 1);
+		char *p;
+		if(!bump){
+			p = (char *) ::operator new(size);
+			allocations++;
+			push_block(p);
+		}else{
+			if(size > (size_t) (limit - next))
+				grow(size);
+			p = next;
+			next += size;
+		}
+		if(destroy != NULL){
+			size_t capacity = dtors.capacity();
+			dtors.push_back(make_pair(destroy, (void *) p));
+			if(dtors.capacity() != capacity)
+				allocations++;
+		}
+		objects++;
+		bytes += size;
+		return p;
+	}
+
+	// undo the registration of an object whose constructor threw
+	void abandon(void *p){
+		if(!dtors.empty() && dtors.back().second == p)
+			dtors.pop_back();
+	}
+
+	void release(){
+		for(auto i = dtors.rbegin(); i != dtors.rend(); ++i)
+			i->first(i->second);
+		dtors.clear();
+		for(auto b : blocks)
+			::operator delete(b);
+		blocks.clear();
+		next = limit = NULL;
+		objects = bytes = allocations = 0;
+	}
+
+	void swap(arena &other){
+		std::swap(next, other.next);
+		std::swap(limit, other.limit);
+		std::swap(bump, other.bump);
+		std::swap(objects, other.objects);
+		std::swap(bytes, other.bytes);
+		std::swap(allocations, other.allocations);
+		blocks.swap(other.blocks);
+		dtors.swap(other.dtors);
+	}
+
+	void set_bump(bool b){ bump = b; }
+	size_t object_count(){ return objects; }
+	size_t byte_count(){ return bytes; }
+	// heap blocks the arena holds; one per node when not bump allocating
+	size_t block_count(){ return blocks.size(); }
+	// heap calls the arena has made since it was last released: its
+	// blocks and the growth of its own bookkeeping
+	size_t allocation_count(){ return allocations; }
+
+private:
+	static const size_t align = 16;
+	static const size_t chunk_size = 64 * 1024;
+
+	void grow(size_t size){
+		size_t n = size > chunk_size ? size : chunk_size;
+		next = (char *) ::operator new(n);
+		limit = next + n;
+		allocations++;
+		push_block(next);
+	}
+
+	void push_block(char *b){
+		size_t capacity = blocks.capacity();
+		blocks.push_back(b);
+		if(blocks.capacity() != capacity)
+			allocations++;
+	}
+
+	arena(const arena &);
+	arena &operator=(const arena &);
+
+	char *next;
+	char *limit;
+	bool bump;
+	size_t objects;
+	size_t bytes;
+	size_t allocations;
+	vector<char *> blocks;
+	vector<pair<void (*)(void *), void *> > dtors;
+};
@@ -0,0 +1,133 @@
+#include <string>
+#include <vector>
+#include <ostream>
+#include <stdexcept>
+
+using namespace std;
+
+// the binary AST starts with this magic and version
+static const char ast_magic[4] = { 'D', 'A', 'S', 'T' };
+static const unsigned ast_version = 2;
+
+// ast_writer - encodes a tree as a preorder stream of LEB128 numbers. Every
+// node is its NodeKind followed by its fields; an identifier or literal is
+// spelled out the first time it appears and referenced by index after that.
+class ast_writer{
+
+public:
+	ast_writer(ostream &o) : os(o), next_index(0) {
+		os.write(ast_magic, sizeof(ast_magic));
+		number(ast_version);
+	}
+
+	void number(unsigned long n){
+		do {
+			unsigned char b = n & 0x7f;
+			n >>= 7;
+			if(n != 0)
+				b |= 0x80;
+			os.put(b);
+		} while(n != 0);
+	}
+
+	// zigzag so small negative numbers stay short
+	void signed_number(long n){
+		number(((unsigned long) n << 1) ^ (unsigned long) (n >> (sizeof(long) * 8 - 1)));
+	}
+
+	void kind(NodeKind k){ number(k); }
+
+	void name(atom a){
+		if((size_t) a >= index.size())
+			index.resize(a + 1, 0);
+		if(index[a] != 0){
+			number(index[a]);
+			return;
+		}
+		index[a] = ++next_index;
+		const string &s = atoms.spelling(a);
+		number(0);
+		number(s.size());
+		os.write(s.data(), s.size());
+	}
+
+	void range(source_range r){
+		number(r.lineno);
+		number(r.offset);
+		number(r.length);
+	}
+
+private:
+	ostream &os;
+	// 1 + position in the stream's atom list, or 0 if not written yet
+	vector<unsigned> index;
+	unsigned next_index;
+};
+
+// ast_reader - decodes what ast_writer wrote; throws on malformed input
+class ast_reader{
+
+public:
+	ast_reader(const char *data, size_t size) : p(data), end(data + size) {
+		if(size < sizeof(ast_magic) || memcmp(data, ast_magic, sizeof(ast_magic)) != 0)
+			throw runtime_error("not a binary AST file");
+		p += sizeof(ast_magic);
+		if(number() != ast_version)
+			throw runtime_error("unsupported binary AST version");
+	}
+
+	unsigned long number(){
+		unsigned long n = 0;
+		for(int shift = 0; ; shift += 7){
+			if(p == end || shift >= 64)
+				throw runtime_error("truncated binary AST");
+			unsigned char b = *p++;
+			n |= (unsigned long) (b & 0x7f) << shift;
+			if((b & 0x80) == 0)
+				return n;
+		}
+	}
+
+	long signed_number(){
+		unsigned long n = number();
+		return (long) (n >> 1) ^ -(long) (n & 1);
+	}
+
+	NodeKind kind(){
+		unsigned long k = number();
+		if(k > LastNodeKind)
+			throw runtime_error("bad node kind in binary AST");
+		return (NodeKind) k;
+	}
+
+	atom name(){
+		unsigned long i = number();
+		if(i != 0){
+			if(i > names.size())
+				throw runtime_error("bad name reference in binary AST");
+			return names[i - 1];
+		}
+		unsigned long len = number();
+		if(len > (size_t) (end - p))
+			throw runtime_error("truncated binary AST");
+		atom a = atoms.intern(p, len);
+		p += len;
+		names.push_back(a);
+		return a;
+	}
+
+	source_range range(){
+		source_range r;
+		r.lineno = number();
+		r.offset = number();
+		r.length = number();
+		return r;
+	}
+
+	bool done(){ return p == end; }
+
+private:
+	const char *p;
+	const char *end;
+	vector<atom> names;
+};
@@ -0,0 +1,101 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+
+// FNV-1a; pass the previous result as h to hash several pieces as one
+inline unsigned int fnv1a(const char *s, size_t len, unsigned int h = 2166136261u){
+	for(size_t i = 0; i < len; i++){
+		h ^= (unsigned char) s[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+// atom - compact id for an interned identifier or literal spelling
+typedef int atom;
+
+// atomtable is shared by every compilation in the process. intern() is
+// serialized by a mutex; spelling() takes no lock because spellings live in
+// fixed chunks that never move once an id has been handed out.
+class atomtable{
+
+public:
+	atomtable() : slots(initial_slots, -1), count(0) {
+		memset(chunks, 0, sizeof(chunks));
+	}
+	~atomtable(){
+		for(int i = 0; i < max_chunks && chunks[i] != NULL; i++)
+			delete[] chunks[i];
+	}
+
+	atom intern(const char *s, size_t len){
+		unsigned int h = fnv1a(s, len);
+		lock_guard<mutex> lock(intern_lock);
+		size_t mask = slots.size() - 1;
+		for(size_t i = h & mask; ; i = (i + 1) & mask){
+			atom a = slots[i];
+			if(a == -1){
+				a = count;
+				if((a & chunk_mask) == 0){
+					if((a >> chunk_bits) == max_chunks)
+						throw runtime_error("too many distinct identifiers");
+					chunks[a >> chunk_bits] = new string[chunk_size];
+				}
+				chunks[a >> chunk_bits][a & chunk_mask].assign(s, len);
+				hashes.push_back(h);
+				slots[i] = a;
+				count++;
+				if((size_t) count * 2 > slots.size())
+					grow();
+				return a;
+			}
+			if(hashes[a] == h){
+				const string &name = spelling(a);
+				if(name.size() == len && memcmp(name.data(), s, len) == 0)
+					return a;
+			}
+		}
+	}
+
+	atom intern(const string &s){
+		return intern(s.data(), s.size());
+	}
+
+	const string &spelling(atom a){
+		return chunks[a >> chunk_bits][a & chunk_mask];
+	}
+
+	int size(){
+		lock_guard<mutex> lock(intern_lock);
+		return count;
+	}
+
+private:
+	static const size_t initial_slots = 1024;
+	static const int chunk_bits = 10;
+	static const int chunk_size = 1 << chunk_bits;
+	static const int chunk_mask = chunk_size - 1;
+	static const int max_chunks = 1 << 14;
+
+	void grow(){
+		vector<atom> bigger(slots.size() * 2, -1);
+		size_t mask = bigger.size() - 1;
+		for(atom a = 0; a < count; a++){
+			size_t i = hashes[a] & mask;
+			while(bigger[i] != -1)
+				i = (i + 1) & mask;
+			bigger[i] = a;
+		}
+		slots.swap(bigger);
+	}
+
+	mutex intern_lock;
+	vector<atom> slots;
+	vector<unsigned int> hashes;
+	string *chunks[max_chunks];
+	atom count;
+};
@@ -0,0 +1,114 @@
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+class decafAST;
+class Expr;
+
+// how array indexes are checked: not at all, on every access, or on every
+// access the range finder could not prove in bounds
+enum bounds_mode { BoundsOff, BoundsAlways, BoundsElide };
+
+// loop_range - what the range finder proved about a for or while loop.
+// On every pass through the body, var lies between the value it had when
+// the loop was entered (start, if that is a known constant) and bound:
+// counting up to bound, or down to it when down is set, and reaching it
+// only when inclusive is set. size is the smallest array the body indexes
+// with var; var is NULL when nothing was proved.
+struct loop_range {
+	loop_range() : var(NULL), start(NULL), bound(NULL), down(false), inclusive(false), size(0) {}
+	decafAST *var;
+	Expr *start;
+	Expr *bound;
+	bool down;
+	bool inclusive;
+	uint64_t size;
+};
+
+// bounds_checker - emits the index checks of the method being generated.
+// A failed check branches to one block per method that traps. While the
+// body of a loop with a proven range is generated, its variable comes
+// with a guard computed once before the loop, saying the whole range fits
+// the arrays. An index read from that variable is checked only when the
+// guard fails, as an or of the guard and the compare. When start and
+// bound are constants the guard is a constant, and true drops the check
+// altogether; otherwise loop unswitching can split the loop on the guard.
+class bounds_checker {
+public:
+	bounds_checker() : mode(BoundsElide), fail(NULL) {}
+
+	// start a new method
+	void begin(){
+		fail = NULL;
+		proven.clear();
+	}
+
+	// the body of a loop over var is about to be generated; inRange holds
+	// when var stays inside [0, size) for the whole loop
+	void enter(decafAST *var, uint64_t size, llvm::Value *inRange){
+		fact f = { var, size, inRange };
+		proven.push_back(f);
+	}
+	void leave(){
+		proven.pop_back();
+	}
+
+	// check that idx indexes an array of n elements before the code that
+	// follows it runs; var is the variable idx was read from, if the index
+	// is just that. Returns the block the check continues in, which the
+	// caller's SSA construction has to seal.
+	llvm::BasicBlock *check(llvm::Value *idx, uint64_t n, decafAST *var, llvm::IRBuilder<> &b){
+		if(mode == BoundsOff)
+			return NULL;
+		llvm::Value *guard = NULL;
+		if(mode == BoundsElide){
+			if(llvm::ConstantInt *c = llvm::dyn_cast<llvm::ConstantInt>(idx))
+				if(c->getSExtValue() >= 0 && (uint64_t) c->getSExtValue() < n)
+					return NULL;
+			for(auto i = proven.rbegin(); i != proven.rend() && guard == NULL; ++i)
+				if(var != NULL && i->var == var && i->size <= n)
+					guard = i->inRange;
+			if(llvm::ConstantInt *c = llvm::dyn_cast_or_null<llvm::ConstantInt>(guard)){
+				if(c->isOne())
+					return NULL;
+				guard = NULL;
+			}
+		}
+		// negative indexes are large unsigned ones, so one compare does
+		llvm::Value *ok = b.CreateICmpULT(idx, llvm::ConstantInt::get(idx->getType(), n), "inbounds");
+		if(guard != NULL)
+			ok = b.CreateOr(guard, ok, "inbounds");
+		llvm::Function *f = b.GetInsertBlock()->getParent();
+		llvm::BasicBlock *cont = llvm::BasicBlock::Create(b.getContext(), "inbounds", f);
+		b.CreateCondBr(ok, cont, failBlock(f));
+		b.SetInsertPoint(cont);
+		return cont;
+	}
+
+	bounds_mode mode;
+
+private:
+	llvm::BasicBlock *failBlock(llvm::Function *f){
+		if(fail == NULL){
+			fail = llvm::BasicBlock::Create(f->getContext(), "outofbounds", f);
+			llvm::IRBuilder<> at(fail);
+			at.CreateCall(llvm::Intrinsic::getDeclaration(f->getParent(), llvm::Intrinsic::trap));
+			at.CreateUnreachable();
+		}
+		return fail;
+	}
+
+	struct fact {
+		decafAST *var;
+		uint64_t size;
+		llvm::Value *inRange;
+	};
+	// the ranges of the loops being generated, innermost last
+	vector<fact> proven;
+	llvm::BasicBlock *fail;
+};
@@ -0,0 +1,48 @@
+using namespace std;
+
+// compile_options - the switches that decide what a program compiles to.
+// A normal compile and watch mode take the same set, so a rebuild in watch
+// mode prints what a compile with the same flags would.
+struct compile_options {
+	compile_options() : fast_scan(false), jobs(1), parallel_codegen(false), fold(true), ssa(false), bounds(BoundsElide), opt_level(0) {}
+	bool fast_scan;
+	// threads for checking, and for codegen with parallel_codegen; 0 is
+	// one per core
+	unsigned jobs;
+	bool parallel_codegen;
+	bool fold;
+	bool ssa;
+	bounds_mode bounds;
+	unsigned opt_level;
+};
+
+// prepare_program - resolve and type check prog, then fold it unless
+// -no-fold and find the loop ranges bounds-check elision uses. Returns
+// false, with the diagnostics printed, if it does not check; throws on a
+// name that does not resolve.
+bool prepare_program(ProgramAST *prog, arena &nodes, thread_pool &pool, const compile_options &opts){
+	resolve_names(prog);
+	if(!check_program(prog, pool))
+		return false;
+	if(opts.fold)
+		fold_program(prog, nodes);
+	find_ranges(prog);
+	return true;
+}
+
+// set up cx to generate code as opts say
+void configure_codegen(codegen_context &cx, const compile_options &opts){
+	cx.ssa.enabled = opts.ssa;
+	cx.bounds.mode = opts.bounds;
+}
+
+// generate_program - generate a prepared program into cx's module, on the
+// pool with -parallel-codegen, and run the -O pipeline over it
+void generate_program(ProgramAST *prog, thread_pool &pool, codegen_context &cx, const compile_options &opts){
+	configure_codegen(cx, opts);
+	if(opts.parallel_codegen)
+		codegen_parallel(prog, pool, cx);
+	else
+		prog->Codegen(cx);
+	optimize_module(cx.TheModule, opts.opt_level);
+}
@@ -8,6 +8,10 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Casting.h"
 #include <cstdio> 
 #include <cstdlib>
 #include <cstring> 
@@ -18,35 +22,127 @@
 
 using namespace std;
 
-extern int lineno;
-extern int tokenpos;
+#include "atom_table.cc"
+#include "source_file.cc"
+#include "arena.cc"
 
+extern atomtable atoms;
+
+// source_range - offset/length view of a token or rule in the source text
+struct source_range {
+	int lineno;
+	int offset;
+	int length;
+};
+#define YYLTYPE source_range
+#define YYLTYPE_IS_DECLARED 1
+#define YYLLOC_DEFAULT(Cur, Rhs, N) \
+	do { \
+		if (N) { \
+			(Cur).lineno = YYRHSLOC(Rhs, 1).lineno; \
+			(Cur).offset = YYRHSLOC(Rhs, 1).offset; \
+			(Cur).length = YYRHSLOC(Rhs, N).offset + YYRHSLOC(Rhs, N).length - (Cur).offset; \
+		} else { \
+			(Cur).lineno = YYRHSLOC(Rhs, 0).lineno; \
+			(Cur).offset = YYRHSLOC(Rhs, 0).offset + YYRHSLOC(Rhs, 0).length; \
+			(Cur).length = 0; \
+		} \
+	} while (0)
+
+// NodeKind - the tag every decafAST carries, so passes can switch on it
+// (and isa<>/cast<>/dyn_cast<> can check it) instead of probing fields.
+// Expr and StatementAST get one kind per form; the ranges are contiguous.
+enum NodeKind {
+	NullNode,
+	StmtListNode,
+	PackageNode,
+	ProgramNode,
+	DecafTypeNode,
+	MethodTypeNode,
+	ExternTypeNode,
+	TypedSymbolNode,
+	ExternNode,
+	BinaryOperatorNode,
+	UnaryOperatorNode,
+	MethodCallNode,
+	RvalueExprNode,
+	CallExprNode,
+	IntExprNode,
+	BoolExprNode,
+	BinaryExprNode,
+	UnaryExprNode,
+	FieldSizeNode,
+	FieldDeclNode,
+	MethodArgNode,
+	MethodBlockNode,
+	MethodDeclNode,
+	RvalueNode,
+	AssignNode,
+	BlockNode,
+	AssignStmtNode,
+	CallStmtNode,
+	IfStmtNode,
+	WhileStmtNode,
+	ForStmtNode,
+	ReturnStmtNode,
+	VoidReturnStmtNode,
+	BreakStmtNode,
+	ContinueStmtNode,
+	BlockStmtNode,
+	FirstExprKind = RvalueExprNode,
+	LastExprKind = UnaryExprNode,
+	FirstStmtKind = AssignStmtNode,
+	LastStmtKind = BlockStmtNode,
+	LastNodeKind = BlockStmtNode
+};
+
+#include "ast_io.cc"
+
+// parse_state - everything one compilation's scanner and parser share;
+// nothing about a parse lives in globals so several can run at once
+struct parse_state {
+	int lineno;
+	int tokenpos;
+	int offset;
+	void *scanner;
+	bool fast_scan;
+	class decafscanner *fast;
+	class ProgramAST *prog;
+	arena nodes;
+	parse_state() : lineno(1), tokenpos(1), offset(0), scanner(NULL), fast_scan(false), fast(NULL), prog(NULL) {}
+};
+
+class decafAST;
+
+// descriptor - what the symbol table knows about a name: the node that
+// declared it
 class descriptor{
 public:
 	int lineno;
-	llvm::Value *val;
-	descriptor(int num){
-		lineno = num;
-	}
-	descriptor(llvm::Value *v){
-		val = v;		
-	}
+	decafAST *decl;
+	descriptor() : lineno(0), decl(NULL) {}
+	descriptor(int num) : lineno(num), decl(NULL) {}
+	descriptor(decafAST *d) : lineno(0), decl(d) {}
 	void print(){
 		cerr << "line: " << lineno << endl;
 	}
-	llvm::Value *getVal(){
-		return val;
+	decafAST *getDecl(){
+		return decl;
 	}
 };
 
 #include "symbol_table.cc"
+#include "ssa_builder.cc"
+#include "stack_frame.cc"
+#include "bounds_check.cc"
+
+union YYSTYPE;
 
-extern "C"
-{
-	extern int yyerror(const char *);
-	int yyparse(void);
-	int yylex(void);  
-	int yywrap(void);
-}
+int yyerror(YYLTYPE *llocp, parse_state *ps, const char *);
+int yyparse(parse_state *ps);
+int yylex(union YYSTYPE *lvalp, YYLTYPE *llocp, parse_state *ps);
+int parse_decaf(FILE *in, parse_state *ps);
+int parse_decaf(source_file &src, parse_state *ps);
+void bench_scanners(source_file &src, int reps);
 
 #endif
\ No newline at end of file
@@ -12,31 +12,93 @@ using namespace std;
 
 /// decafAST - Base class for all abstract syntax tree nodes.
 
-// this global variable contains all the generated code
-static llvm::Module *TheModule;
-
-// this is the method used to construct the LLVM intermediate code (IR)
-static llvm::IRBuilder<> Builder(llvm::getGlobalContext());
-// the calls to getGlobalContext() in the init above and in the
-// following code ensures that we are incrementally generating
-// instructions in the right order
+// codegen_context - the state of one compilation's code generation: the
+// module that receives the generated code, the builder that appends
+// instructions to it, what each declaration stands for in the module, the
+// stack frame of the method being generated or its SSA values when -ssa
+// is on, its array bounds checks, and whether it still needs a default
+// return. The context owns its module, so nothing outlives the
+// compilation unless release() hands it over. Codegen only reads the AST,
+// so contexts share nothing: a host can keep one per thread, each on an
+// LLVMContext of its own, and compile program after program, or the same
+// program, through them.
+class codegen_context {
+public:
+	codegen_context(llvm::LLVMContext &c, const string &name) : TheModule(new llvm::Module(name, c)), Builder(c), defaultRet(true) {}
+	~codegen_context() { delete TheModule; }
+	llvm::LLVMContext &getContext() { return Builder.getContext(); }
+	// start over on an empty module, e.g. for the next program
+	void reset(const string &name) {
+		Builder.ClearInsertionPoint();
+		defaultRet = true;
+		decls.clear();
+		delete TheModule;
+		TheModule = new llvm::Module(name, getContext());
+	}
+	// hand the module to the caller, who then has to delete it
+	llvm::Module *release() {
+		llvm::Module *m = TheModule;
+		Builder.ClearInsertionPoint();
+		decls.clear();
+		TheModule = NULL;
+		return m;
+	}
 
-symboltable syms;
-bool defaultRet = true;
+	// this contains all the generated code
+	llvm::Module *TheModule;
+	// this is the method used to construct the LLVM intermediate code (IR)
+	llvm::IRBuilder<> Builder;
+	// the global of each field, the function of each extern and method,
+	// and the stack slot of each local and parameter, keyed by declaration
+	llvm::DenseMap<decafAST *, llvm::Value *> decls;
+	stack_frame frame;
+	ssa_builder ssa;
+	bounds_checker bounds;
+	bool defaultRet;
+
+private:
+	codegen_context(const codegen_context &);
+	codegen_context &operator=(const codegen_context &);
+};
 
-void enter_symtbl(string ident, llvm::Value *v){
-    syms.enter_symtbl(ident, new descriptor(v));
-    //cerr << "defined variable: " << ident << ", with type: " << type << ", on line number: " << lineno << endl;
-}
+class decafAST;
+llvm::Value *declValue(decafAST *d, codegen_context &cx);
 
 class decafAST {
+  const NodeKind kind;
 public:
+  decafAST(NodeKind k) : kind(k) {}
   virtual ~decafAST() {}
-  virtual string str() { return string(""); }
-  virtual llvm::Value *Codegen() = 0;
-  virtual llvm::Value *proto(){return 0;};
+  NodeKind getKind() const { return kind; }
+  // nodes live in their compilation's arena and are freed with it, never by delete
+  static void *operator new(size_t size, arena &a) { return a.allocate(size, destroy_object<decafAST>); }
+  static void operator delete(void *p, arena &a) { a.abandon(p); }
+  static void operator delete(void *) {}
+  // write the node's AST dump to os; str() is the same text as a string
+  virtual void print(ostream &os) {}
+  string str() { ostringstream os; print(os); return os.str(); }
+  // append the node to a binary AST; read_node turns it back into a node
+  virtual void write(ast_writer &w) = 0;
+  virtual llvm::Value *Codegen(codegen_context &cx) = 0;
+  virtual llvm::Value *proto(codegen_context &cx){return 0;};
 };
 
+void printNode(ostream &os, decafAST *d) {
+	if (d != NULL) {
+		d->print(os);
+	} else {
+		os << "None";
+	}
+}
+
+void writeNode(ast_writer &w, decafAST *d) {
+	if (d != NULL) {
+		d->write(w);
+	} else {
+		w.kind(NullNode);
+	}
+}
+
 string getString(decafAST *d) {
 	if (d != NULL) {
 		return d->str();
@@ -46,34 +108,35 @@ string getString(decafAST *d) {
 }
 
 template <class T>
-string commaList(list<T> vec) {
-    string s("");
-    for (typename list<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
-        s = s + (s.empty() ? string("") : string(",")) + (*i)->str(); 
-    }   
-    if (s.empty()) {
-        s = string("None");
-    }   
-    return s;
+void printList(ostream &os, llvm::ArrayRef<T> vec) {
+	if (vec.empty()) {
+		os << "None";
+	}
+	for (typename llvm::ArrayRef<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
+		if (i != vec.begin()) {
+			os << ',';
+		}
+		(*i)->print(os);
+	}
 }
 
 template <class T>
-llvm::Value *listCodegen(list<T> vec) {
+llvm::Value *listCodegen(llvm::ArrayRef<T> vec, codegen_context &cx) {
 	llvm::Value *val = NULL;
-	for (typename list<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
-		llvm::Value *j = (*i)->Codegen();
+	for (typename llvm::ArrayRef<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
+		llvm::Value *j = (*i)->Codegen(cx);
 		if (j != NULL) { val = j; }
 	}	
 	return val;
 }
 
 template <class T>
-vector<llvm::Type *> vectorCodegenTypes(list<T> vec){
+vector<llvm::Type *> vectorCodegenTypes(llvm::ArrayRef<T> vec, codegen_context &cx){
 	
 	vector<llvm::Type*> params;
 	llvm::Type *t = NULL;
-	for (typename list<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
-		llvm::Type *j = (llvm::Type *)(*i)->Codegen();//->getType();
+	for (typename llvm::ArrayRef<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
+		llvm::Type *j = (llvm::Type *)(*i)->Codegen(cx);//->getType();
 		if (j != NULL) {
 		 	t = j; 
 		 	params.push_back(t);
@@ -82,39 +145,12 @@ vector<llvm::Type *> vectorCodegenTypes(list<T> vec){
 	return params;
 }
 template <class T>
-vector<llvm::Type *> vectorMethodParamTypes(list<T> vec){
-	
-	vector<llvm::Type*> params;
-	llvm::Type *t = NULL;
-	/*for (typename list<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
-		llvm::Type *j = (*i)->Codegen()->getType();
-		if (j != NULL) {
-		 	t = j; 
-		 	params.push_back(t);
-		 }
-	}*/
-	llvm::Type *intType = Builder.getInt32Ty();
-	llvm::Type *boolType = Builder.getInt1Ty();
-
-	for (typename list<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
-		llvm::Type *j = (*i)->Codegen()->getType();
-		if (j == intType->getPointerTo()) {
-		 	params.push_back(Builder.getInt32Ty());
-		 }else if( j == boolType->getPointerTo()){
-		 	params.push_back(Builder.getInt1Ty());
-		 }else{
-		 	throw runtime_error("VECTORMETHODPARAMSTYPE WRONG");
-		 }
-	}	 
-	return params;
-}
-template <class T>
-vector<llvm::Value *> vectorMethodArgs(list<T> vec){
+vector<llvm::Value *> vectorMethodArgs(llvm::ArrayRef<T> vec, codegen_context &cx){
 	
 	vector<llvm::Value*> params;
 	llvm::Value *v = NULL;
-	for (typename list<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
-		llvm::Value *j = (*i)->Codegen();
+	for (typename llvm::ArrayRef<T>::iterator i = vec.begin(); i != vec.end(); i++) { 
+		llvm::Value *j = (*i)->Codegen(cx);
 		if (j != NULL) {
 		 	v = j; 
 		 	params.push_back(v);
@@ -124,69 +160,79 @@ vector<llvm::Value *> vectorMethodArgs(list<T> vec){
 }
 
 
-/// decafStmtList - List of Decaf statements
+/// decafStmtList - List of Decaf statements, stored contiguously and
+/// handed out as an ArrayRef so walking a list never copies it
 class decafStmtList : public decafAST {
-	list<decafAST *> stmts;
+	llvm::SmallVector<decafAST *, 4> stmts;
 public:
-	decafStmtList() {}
-	~decafStmtList() {
-		for (list<decafAST *>::iterator i = stmts.begin(); i != stmts.end(); i++) { 
-			delete *i;
-		}
-	}
+	decafStmtList() : decafAST(StmtListNode) {}
+	~decafStmtList() {}
+	static bool classof(const decafAST *n) { return n->getKind() == StmtListNode; }
 	int size() { return stmts.size(); }
-	void push_front(decafAST *e) { stmts.push_front(e); }
 	void push_back(decafAST *e) { stmts.push_back(e); }
-	string str() { return commaList<class decafAST *>(stmts); }
-	list<decafAST *> getList(){return stmts;}
-	llvm::Value *Codegen() { 
-		return listCodegen<decafAST *>(stmts); 
+	void print(ostream &os) { printList<decafAST *>(os, stmts); }
+	void write(ast_writer &w) {
+		w.kind(StmtListNode);
+		w.number(stmts.size());
+		for(auto s : stmts)
+			writeNode(w, s);
 	}
-	vector<llvm::Type *> getParamTypes(){
-		return vectorCodegenTypes<decafAST *>(stmts);
+	llvm::ArrayRef<decafAST *> getList(){return stmts;}
+	decafAST **begin() { return stmts.begin(); }
+	decafAST **end() { return stmts.end(); }
+	decafAST **erase(decafAST **i) { return stmts.erase(i); }
+	llvm::Value *Codegen(codegen_context &cx) { 
+		return listCodegen<decafAST *>(stmts, cx); 
 	}
-	vector<llvm::Type *> getMethodParamTypes(){
-		return vectorMethodParamTypes<decafAST *>(stmts);
+	vector<llvm::Type *> getParamTypes(codegen_context &cx){
+		return vectorCodegenTypes<decafAST *>(stmts, cx);
 	}
-	vector<llvm::Value *> getMethodArgs(){
-		return vectorMethodArgs<decafAST *>(stmts);
+	vector<llvm::Value *> getMethodArgs(codegen_context &cx){
+		return vectorMethodArgs<decafAST *>(stmts, cx);
 	}
 };
 
 class PackageAST : public decafAST {
-	string Name;
+	atom Name;
 	decafStmtList *FieldDeclList;
 	decafStmtList *MethodDeclList;
 public:
-	PackageAST(string name, decafStmtList *fieldlist, decafStmtList *methodlist) 
-		: Name(name), FieldDeclList(fieldlist), MethodDeclList(methodlist) {}
-	~PackageAST() { 
-		if (FieldDeclList != NULL) { delete FieldDeclList; }
-		if (MethodDeclList != NULL) { delete MethodDeclList; }
+	PackageAST(atom name, decafStmtList *fieldlist, decafStmtList *methodlist) 
+		: decafAST(PackageNode), Name(name), FieldDeclList(fieldlist), MethodDeclList(methodlist) {}
+	~PackageAST() {}
+	static bool classof(const decafAST *n) { return n->getKind() == PackageNode; }
+	void print(ostream &os) { 
+		os << "Package(" << atoms.spelling(Name) << ',';
+		printNode(os, FieldDeclList);
+		os << ',';
+		printNode(os, MethodDeclList);
+		os << ')';
 	}
-	string str() { 
-		return string("Package") + "(" + Name + "," + getString(FieldDeclList) + "," + getString(MethodDeclList) + ")";
+	void write(ast_writer &w) {
+		w.kind(PackageNode);
+		w.name(Name);
+		writeNode(w, FieldDeclList);
+		writeNode(w, MethodDeclList);
 	}
-	llvm::Value *Codegen() { 
+	llvm::Value *Codegen(codegen_context &cx) { 
 		for(auto m : MethodDeclList->getList()){
-			m->proto();
+			m->proto(cx);
 		}
 
-		syms.new_symtbl();
-		
 		llvm::Value *val = NULL;
-		TheModule->setModuleIdentifier(llvm::StringRef(Name)); 
+		cx.TheModule->setModuleIdentifier(llvm::StringRef(atoms.spelling(Name))); 
 		if (NULL != FieldDeclList) {
-			val = FieldDeclList->Codegen();
+			val = FieldDeclList->Codegen(cx);
 		}
 		if (NULL != MethodDeclList) {
-			val = MethodDeclList->Codegen();
+			val = MethodDeclList->Codegen(cx);
 		} 
 
-		syms.remove_symtbl();
-		// Q: should we enter the class name into the symbol table?
 		return val; 
 	}
+	atom getName(){ return Name; }
+	decafStmtList *getFields(){ return FieldDeclList; }
+	decafStmtList *getMethods(){ return MethodDeclList; }
 };
 
 /// ProgramAST - the decaf program
@@ -194,359 +240,351 @@ class ProgramAST : public decafAST {
 	decafStmtList *ExternList;
 	PackageAST *PackageDef;
 public:
-	ProgramAST(decafStmtList *externs, PackageAST *c) : ExternList(externs), PackageDef(c) {}
-	~ProgramAST() { 
-		if (ExternList != NULL) { delete ExternList; } 
-		if (PackageDef != NULL) { delete PackageDef; }
-	}
-	string str() { return string("Program") + "(" + getString(ExternList) + "," + getString(PackageDef) + ")"; }
-	llvm::Value *Codegen() { 
-		syms.new_symtbl();
+	ProgramAST(decafStmtList *externs, PackageAST *c) : decafAST(ProgramNode), ExternList(externs), PackageDef(c) {}
+	~ProgramAST() {}
+	static bool classof(const decafAST *n) { return n->getKind() == ProgramNode; }
+	void print(ostream &os) {
+		os << "Program(";
+		printNode(os, ExternList);
+		os << ',';
+		printNode(os, PackageDef);
+		os << ')';
+	}
+	void write(ast_writer &w) {
+		w.kind(ProgramNode);
+		writeNode(w, ExternList);
+		writeNode(w, PackageDef);
+	}
+	llvm::Value *Codegen(codegen_context &cx) { 
 		llvm::Value *val = NULL;
 		if (NULL != ExternList) {
-			val = ExternList->Codegen();
+			val = ExternList->Codegen(cx);
 		}
 		if (NULL != PackageDef) {
-			val = PackageDef->Codegen();
+			val = PackageDef->Codegen(cx);
 		} else {
 			throw runtime_error("no package definition in decaf program");
 		}
-		syms.remove_symtbl();
 		return val; 
 	}
+	decafStmtList *getExterns(){ return ExternList; }
+	PackageAST *getPackage(){ return PackageDef; }
 };
 
 
-// StringList - list<string> wrapper
+// StringList - contiguous list of atoms
 class StringList{
-	list<string> sList;
+	llvm::SmallVector<atom, 4> sList;
 public:
+	static void *operator new(size_t size, arena &a) { return a.allocate(size, destroy_object<StringList>); }
+	static void operator delete(void *p, arena &a) { a.abandon(p); }
+	static void operator delete(void *) {}
 	int size() { return sList.size(); }
-	void push_front(string s) { sList.push_front(s); }
-	void push_back(string s) { sList.push_back(s); }
+	void push_back(atom s) { sList.push_back(s); }
 	string str(){
 		string ret_str;
-		for(list<string>::const_iterator iter = sList.begin(); iter != sList.end(); ++iter){
+		for(const atom *iter = sList.begin(); iter != sList.end(); ++iter){
 			if(iter != sList.begin()){
 				ret_str += ",";
 			}
-			ret_str += *iter;
+			ret_str += atoms.spelling(*iter);
 		}
 		return ret_str;
 	}
-	list<string> getList(){
+	llvm::ArrayRef<atom> getList(){
 		return sList;
 	}
 };
 
 
 
+// Decaf types, in the order of decaf_type_names
+enum DecafType { VoidType, IntType, BoolType, StringType };
+
+static const char *decaf_type_names[] = { "void", "int", "bool", "string" };
+
+llvm::Type *llvmType(DecafType t, codegen_context &cx){
+	switch(t){
+	case VoidType: return cx.Builder.getVoidTy();
+	case IntType: return cx.Builder.getInt32Ty();
+	case BoolType: return cx.Builder.getInt1Ty();
+	case StringType: return cx.Builder.getInt8PtrTy();
+	}
+	throw runtime_error("Invalid decaf type");
+}
+
 class DecafTypeAST : public decafAST{
-	string type;
+	DecafType type;
 public:
-	DecafTypeAST(string t){
-		
-		if(t.compare("int")==0){
-			type = "int";
-		}else if(t.compare("bool")==0){
-			type = "bool";
-		}else{
-			printf("bad type");
-			//exit(EXIT_FAILURE);
-		}
-	}
+	DecafTypeAST(DecafType t) : decafAST(DecafTypeNode), type(t) {}
 	~DecafTypeAST(){}
-	string str(){
-		return type;
+	static bool classof(const decafAST *n) { return n->getKind() == DecafTypeNode; }
+	void print(ostream &os){
+		os << decaf_type_names[type];
 	}
-	llvm::Value *Codegen(){ return 0; };
+	void write(ast_writer &w){
+		w.kind(DecafTypeNode);
+		w.number(type);
+	}
+	DecafType getType(){ return type; }
+	llvm::Value *Codegen(codegen_context &cx){ return 0; };
 };
 
 class MethodTypeAST : public decafAST{
-	string type;
-	DecafTypeAST *decafType;
+	DecafType type;
 public:
-	MethodTypeAST(string t){
-		if(t.compare("void")==0){
-			type = "VoidType";
-		}else if(t.compare("int")==0){
-			type = "IntType";
-		}else if(t.compare("bool")==0){
-			type = "BoolType";
-		}else{
-			printf("bad method type");
-			//exit(EXIT_FAILURE);
-		}
+	MethodTypeAST(DecafType t) : decafAST(MethodTypeNode), type(t) {}
+	MethodTypeAST(DecafTypeAST *dt) : decafAST(MethodTypeNode), type(dt->getType()) {}
+	~MethodTypeAST(){}
+	static bool classof(const decafAST *n) { return n->getKind() == MethodTypeNode; }
+	void print(ostream &os){
+		os << (type == VoidType ? "VoidType" : type == IntType ? "IntType" : "BoolType");
 	}
-	MethodTypeAST(DecafTypeAST *dt){
-		decafType = dt;
-		string t = getString(dt);
-		if(t.compare("void")==0){
-			type = "VoidType";
-		}else if(t.compare("int")==0){
-			type = "IntType";
-		}else if(t.compare("bool")==0){
-			type = "BoolType";
-		}else{
-			printf("bad method type");
-			//exit(EXIT_FAILURE);
-		}
+	void write(ast_writer &w){
+		w.kind(MethodTypeNode);
+		w.number(type);
 	}
-	~MethodTypeAST(){}
-	string str(){
-		return type;
-	}
-	llvm::Value *Codegen(){ 
-		if(type==string("VoidType")){
-			return (llvm::Value *) Builder.getVoidTy();
-		}else if(type==string("IntType")){
-			return (llvm::Value *) Builder.getInt32Ty();
-		}else if(type==string("BoolType")){
-			return (llvm::Value *) Builder.getInt1Ty();
-		}else{
-			throw runtime_error("Invalid method type of "+type);
-		}
-
+	DecafType getType(){ return type; }
+	llvm::Value *Codegen(codegen_context &cx){ 
+		return (llvm::Value *) llvmType(type, cx);
 	};
 };
 
 class ExternTypeAST : public decafAST{
-	string type;
-	DecafTypeAST *decafType;
+	DecafType type;
 public:
-	ExternTypeAST(string t){
-		
-		if(t.compare("string")==0){
-			type = "StringType";
-		}else if(t.compare("int")==0){
-			type = "IntType";
-		}else if(t.compare("bool")==0){
-			type = "BoolType";
-		}else{
-			printf("bad extern type");
-			//exit(EXIT_FAILURE);
-		}
-	}
-	ExternTypeAST(DecafTypeAST *dt){
-		decafType = dt;
-		string t = getString(dt);
-		if(t.compare("string")==0){
-			type = "StringType";
-		}else if(t.compare("int")==0){
-			type = "IntType";
-		}else if(t.compare("bool")==0){
-			type = "BoolType";
-		}else{
-			printf("bad extern type");
-			//exit(EXIT_FAILURE);
-		}
-	}
+	ExternTypeAST(DecafType t) : decafAST(ExternTypeNode), type(t) {}
+	ExternTypeAST(DecafTypeAST *dt) : decafAST(ExternTypeNode), type(dt->getType()) {}
 	~ExternTypeAST(){}
-	string str(){
-		return string("VarDef") + '(' + type.c_str() + ')';
+	static bool classof(const decafAST *n) { return n->getKind() == ExternTypeNode; }
+	DecafType getType(){ return type; }
+	void print(ostream &os){
+		os << "VarDef(" << (type == StringType ? "StringType" : type == IntType ? "IntType" : "BoolType") << ')';
 	}
-	llvm::Value *Codegen(){ 
-		if(type == "IntType"){
-			return (llvm::Value *) Builder.getInt32Ty();
-		}
-		else if(type == "BoolType"){
-			return (llvm::Value *) Builder.getInt1Ty();
-		}
-		else if(type == "StringType"){
-			return (llvm::Value *) Builder.getInt8PtrTy();
-		}
-		else{
-			throw runtime_error("Invalid extern type of " + type);
-		}
-
+	void write(ast_writer &w){
+		w.kind(ExternTypeNode);
+		w.number(type);
+	}
+	llvm::Value *Codegen(codegen_context &cx){ 
+		return (llvm::Value *) llvmType(type, cx);
 	}
 };
 
 
 class TypedSymbolAST : public decafAST {
-	string name;
+	atom name;
 	DecafTypeAST *type;
 public:
-	TypedSymbolAST(string n, DecafTypeAST *t) : name(n), type(t) {}
+	TypedSymbolAST(atom n, DecafTypeAST *t) : decafAST(TypedSymbolNode), name(n), type(t) {}
 	~TypedSymbolAST(){}
-	string str()
+	static bool classof(const decafAST *n) { return n->getKind() == TypedSymbolNode; }
+	void print(ostream &os)
+	{
+		os << "VarDef(" << atoms.spelling(name) << ',';
+		printNode(os, type);
+		os << ')';
+	}
+	void write(ast_writer &w)
 	{
-		return string("VarDef") + "(" + name + "," + getString(type) + ")";
+		w.kind(TypedSymbolNode);
+		w.name(name);
+		writeNode(w, type);
 	}
-	string getName(){
+	atom getName(){
 		return name;
 	}
-	string getTypeStr(){
-		return type->str();
+	DecafType getType(){
+		return type->getType();
 	}
-	llvm::Value *Codegen(){ 
-		llvm::Type *t;
-		if(type->str()==string("int")){
-			t = Builder.getInt32Ty();
-			//llvm::Type *t = llvm::IntegerType::get(getGlobalContext(), 32);
-		}else if(type->str()==string("bool")){
-			t = Builder.getInt1Ty();
-			//llvm::Type *t = llvm::IntegerType::get(getGlobalContext(), 1);
-		}
-
-		llvm::AllocaInst *Alloca;
-		Alloca = Builder.CreateAlloca(t, nullptr, name);
-
-		enter_symtbl(name, Alloca);
-		return Alloca; 
+	DecafTypeAST *getTypeNode(){ return type; }
+	llvm::Value *Codegen(codegen_context &cx){ 
+		if(cx.ssa.enabled){
+			cx.ssa.declare(this, llvmType(type->getType(), cx), atoms.spelling(name));
+			return NULL;
+		}
+		llvm::AllocaInst *slot = cx.frame.allocate(llvmType(type->getType(), cx), atoms.spelling(name), cx.Builder);
+		cx.decls[this] = slot;
+		return slot; 
 	};
 };
 
 
 // ExternAST - external function statements
 class ExternAST : public decafAST {
-	string name;
+	atom name;
 	MethodTypeAST *return_type;
 	decafStmtList *type_list;
 
 public: 
-	ExternAST(string n, MethodTypeAST *rt, decafStmtList *tl){
+	ExternAST(atom n, MethodTypeAST *rt, decafStmtList *tl) : decafAST(ExternNode) {
 		name = n;
 		return_type = rt;
 		type_list = tl;
 	}
 	~ExternAST(){}
-
-	string str(){
-		return string("ExternFunction") + "(" + name + "," + getString(return_type) + "," + getString(type_list) + ")";
+	static bool classof(const decafAST *n) { return n->getKind() == ExternNode; }
+	atom getName(){ return name; }
+	MethodTypeAST *getReturnType(){ return return_type; }
+	decafStmtList *getTypes(){ return type_list; }
+
+	void print(ostream &os){
+		os << "ExternFunction(" << atoms.spelling(name) << ',';
+		printNode(os, return_type);
+		os << ',';
+		printNode(os, type_list);
+		os << ')';
 	}
-	llvm::Value *Codegen(){
-		llvm::Value *val = NULL;
-		llvm::Type *returnTy = (llvm::Type *)return_type -> Codegen();
-		std::vector<llvm::Type *> args = type_list -> getParamTypes();
-		llvm::FunctionType *FT;
+	void write(ast_writer &w){
+		w.kind(ExternNode);
+		w.name(name);
+		writeNode(w, return_type);
+		writeNode(w, type_list);
+	}
+	llvm::FunctionType *functionType(codegen_context &cx){
+		llvm::Type *returnTy = (llvm::Type *)return_type -> Codegen(cx);
+		std::vector<llvm::Type *> args = type_list -> getParamTypes(cx);
 		if(args.size() == 0){
-			FT = llvm::FunctionType::get(returnTy, false);	
-		}
-		else{
-			FT = llvm::FunctionType::get(returnTy, args, false);
+			return llvm::FunctionType::get(returnTy, false);	
 		}
+		return llvm::FunctionType::get(returnTy, args, false);
+	}
+	llvm::Value *Codegen(codegen_context &cx){
 		llvm::Function *func = llvm::Function::Create(
-			FT,
+			functionType(cx),
 			llvm::Function::ExternalLinkage,
-			name,
-			TheModule
+			atoms.spelling(name),
+			cx.TheModule
 			);
-		enter_symtbl(name, func);
+		cx.decls[this] = func;
 		return func;
 	}
 };
 
 
+// Decaf operators, in the order of the lowering tables below
+enum BinaryOp { Plus, Minus, Mult, Div, Leftshift, Rightshift, Mod, Lt, Gt, Leq, Geq, Eq, Neq, And, Or };
+enum UnaryOp { UnaryMinus, Not };
+
+// binop_lowering - how one binary operator prints and which instruction it
+// becomes; opcode is an llvm::Instruction::BinaryOps, or an
+// llvm::CmpInst::Predicate when compare is set
+struct binop_lowering {
+	const char *name;
+	bool compare;
+	unsigned opcode;
+	const char *tmp;
+};
+
+static const binop_lowering binops[] = {
+	{ "Plus", false, llvm::Instruction::Add, "addtmp" },
+	{ "Minus", false, llvm::Instruction::Sub, "subtmp" },
+	{ "Mult", false, llvm::Instruction::Mul, "multmp" },
+	{ "Div", false, llvm::Instruction::SDiv, "divtmp" },
+	{ "Leftshift", false, llvm::Instruction::Shl, "shltmp" },
+	{ "Rightshift", false, llvm::Instruction::LShr, "lshrtmp" },
+	{ "Mod", false, llvm::Instruction::SRem, "modtmp" },
+	{ "Lt", true, llvm::CmpInst::ICMP_SLT, "lcmptmp" },
+	{ "Gt", true, llvm::CmpInst::ICMP_SGT, "gcmptmp" },
+	{ "Leq", true, llvm::CmpInst::ICMP_SLE, "lecmptmp" },
+	{ "Geq", true, llvm::CmpInst::ICMP_SGE, "gecmptmp" },
+	{ "Eq", true, llvm::CmpInst::ICMP_EQ, "eqtmp" },
+	{ "Neq", true, llvm::CmpInst::ICMP_NE, "cmpnetmp" },
+	{ "And", false, llvm::Instruction::And, "andtmp" },
+	{ "Or", false, llvm::Instruction::Or, "ortmp" },
+};
+
+static const char *unop_names[] = { "UnaryMinus", "Not" };
+
 class BinaryOperator : public decafAST {
-	string op;
+	BinaryOp op;
 public:
-	BinaryOperator(string o) : op(o) {}
+	BinaryOperator(BinaryOp o) : decafAST(BinaryOperatorNode), op(o) {}
 	~BinaryOperator() {}
-	string str() {
-		string ret_str;
-		if(op == "+")
-			ret_str = string("Plus");
-		else if(op == "-")
-			ret_str = string("Minus");
-		else if(op == "*")
-			ret_str = string("Mult");
-		else if(op == "/")
-			ret_str = string("Div");
-		else if(op == "<<")
-			ret_str = string("Leftshift");
-		else if(op == ">>")
-			ret_str = string("Rightshift");
-		else if(op == "%")
-			ret_str = string("Mod");
-		else if(op == "<")
-			ret_str = string("Lt");
-		else if(op == ">")
-			ret_str = string("Gt");
-		else if(op == "<=")
-			ret_str = string("Leq");
-		else if(op == ">=")
-			ret_str = string("Geq");
-		else if(op == "==")
-			ret_str = string("Eq");
-		else if(op == "!=")
-			ret_str = string("Neq");
-		else if(op == "&&")
-			ret_str = string("And");
-		else
-			ret_str = string("Or");
-		
-		return ret_str;
+	static bool classof(const decafAST *n) { return n->getKind() == BinaryOperatorNode; }
+	void print(ostream &os) {
+		os << binops[op].name;
+	}
+	void write(ast_writer &w) {
+		w.kind(BinaryOperatorNode);
+		w.number(op);
 	}
-	llvm::Value *Codegen(){ return 0; };
+	BinaryOp getOp() { return op; }
+	llvm::Value *Codegen(codegen_context &cx){ return 0; };
 };
 
 class UnaryOperator : public decafAST {
-	string op;
+	UnaryOp op;
 public:
-	UnaryOperator(string o) : op(o) {}
+	UnaryOperator(UnaryOp o) : decafAST(UnaryOperatorNode), op(o) {}
 	~UnaryOperator() {}
-	string str() {
-		string ret_str;
-		if(op == "-")
-			ret_str = string("UnaryMinus");
-		else
-			ret_str = string("Not");
-		
-		return ret_str;
+	static bool classof(const decafAST *n) { return n->getKind() == UnaryOperatorNode; }
+	void print(ostream &os) {
+		os << unop_names[op];
 	}
-	llvm::Value *Codegen(){ return 0; };
+	void write(ast_writer &w) {
+		w.kind(UnaryOperatorNode);
+		w.number(op);
+	}
+	UnaryOp getOp() { return op; }
+	llvm::Value *Codegen(codegen_context &cx){ return 0; };
 };
 
 class MethodCallAST : public decafAST {
-	string name;
+	atom name;
 	decafStmtList* methodArg_list;
+	decafAST *binding = NULL;
+	DecafType type = VoidType;
 public: 
-	MethodCallAST(string n, decafStmtList *m) : name(n), methodArg_list(m) {}
-	~MethodCallAST() { if(methodArg_list != NULL) { delete methodArg_list; } }
+	MethodCallAST(atom n, decafStmtList *m) : decafAST(MethodCallNode), name(n), methodArg_list(m) {}
+	~MethodCallAST() {}
+	static bool classof(const decafAST *n) { return n->getKind() == MethodCallNode; }
+	atom getName(){ return name; }
+	decafStmtList *getArgs(){ return methodArg_list; }
+	// the ExternAST or MethodDecl the name resolves to
+	decafAST *getBinding(){ return binding; }
+	void setBinding(decafAST *d){ binding = d; }
+	// the return type, filled in by the type checker
+	DecafType getType(){ return type; }
+	void setType(DecafType t){ type = t; }
 	
-	string str(){
-		return string("MethodCall") + "(" + name + "," + getString(methodArg_list) + ")";
+	void print(ostream &os){
+		os << "MethodCall(" << atoms.spelling(name) << ',';
+		printNode(os, methodArg_list);
+		os << ')';
 	}
-	llvm::Value *Codegen(){ 
-
-		descriptor *d = syms.access_symtbl(name);
-		if(d){
-			llvm::Function *call = (llvm::Function *) d->getVal();
+	void write(ast_writer &w){
+		w.kind(MethodCallNode);
+		w.name(name);
+		writeNode(w, methodArg_list);
+	}
+	llvm::Value *Codegen(codegen_context &cx){ 
+		llvm::Function *call = llvm::cast<llvm::Function>(declValue(binding, cx));
 
-			std::vector<llvm::Value *> args_in = methodArg_list->getMethodArgs();
+		std::vector<llvm::Value *> args_in = methodArg_list->getMethodArgs(cx);
 
 		//PROMOTING
-			int argIdx = 0;
-			llvm::Type *t;
-			llvm::Type *t_in;
-			llvm::Value *arg_in;
-			for (auto &Arg : call->args()) {
-				
-				t = Arg.getType();
-				arg_in = args_in.at(argIdx);
-				t_in = arg_in->getType();
-				if(t != t_in){
-					llvm::Value *promo = Builder.CreateZExt(arg_in, t, "zexttmp");
-					args_in[argIdx] = promo;
+		int argIdx = 0;
+		llvm::Type *t;
+		llvm::Type *t_in;
+		llvm::Value *arg_in;
+		for (auto &Arg : call->args()) {
+			
+			t = Arg.getType();
+			arg_in = args_in.at(argIdx);
+			t_in = arg_in->getType();
+			if(t != t_in){
+				llvm::Value *promo = cx.Builder.CreateZExt(arg_in, t, "zexttmp");
+				args_in[argIdx] = promo;
 
-				}
-				argIdx++;
 			}
-
-			bool isVoid = call->getReturnType()->isVoidTy();
-
-			return Builder.CreateCall(
-				call,
-				args_in,
-				isVoid ? "" : "calltmp"
-			);
-
-		}else{
-			//some code about protoypes?
-			throw runtime_error("Method not found in symboltable");
+			argIdx++;
 		}
-		return 0;
+
+		return cx.Builder.CreateCall(
+			call,
+			args_in,
+			type == VoidType ? "" : "calltmp"
+		);
 	};
 	
 };
@@ -554,233 +592,204 @@ public:
 class Expr : public decafAST {
 	decafStmtList *rvalue = NULL;
 	MethodCallAST *method_call_list = NULL;
-	int iValue = -1;
-	bool bValue;
+	int iValue = 0;
+	bool bValue = false;
 	BinaryOperator *bOp = NULL;
 	UnaryOperator *uOp = NULL;
 	Expr *left_value = NULL;
 	Expr *right_value = NULL;
 	Expr *value = NULL;
+	DecafType type = VoidType;
 public:
-	Expr(decafStmtList *rVal) : rvalue(rVal) {}
-	Expr(MethodCallAST *methCall) : method_call_list(methCall) {}
+	Expr(decafStmtList *rVal) : decafAST(RvalueExprNode), rvalue(rVal) {}
+	Expr(MethodCallAST *methCall) : decafAST(CallExprNode), method_call_list(methCall) {}
 
-	Expr(int value) : iValue(value) {}
-	Expr(bool value) : bValue(value) {}
+	Expr(int value) : decafAST(IntExprNode), iValue(value) {}
+	Expr(bool value) : decafAST(BoolExprNode), bValue(value) {}
 
-	Expr(BinaryOperator *op, Expr *lv, Expr *rv) : bOp(op), left_value(lv), right_value(rv) {}
-	Expr(UnaryOperator *op, Expr *v) : uOp(op), value(v) {}
+	Expr(BinaryOperator *op, Expr *lv, Expr *rv) : decafAST(BinaryExprNode), bOp(op), left_value(lv), right_value(rv) {}
+	Expr(UnaryOperator *op, Expr *v) : decafAST(UnaryExprNode), uOp(op), value(v) {}
 	
-	~Expr(){
-		if(rvalue != NULL) { delete rvalue; }
-		if(method_call_list != NULL) { delete method_call_list; }
-		if(bOp != NULL) { delete bOp; }
-		if(uOp != NULL) { delete uOp; }
-		if(left_value != NULL) { delete left_value; }
-		if(right_value != NULL) { delete right_value; }
-		if(value != NULL) { delete value; }
-	} 
-	string str() {
-		string ret_str;
-		if(rvalue != NULL) {
-			ret_str = getString(rvalue);
-		}
-		else if(method_call_list != NULL){
-			ret_str = getString(method_call_list);
+	~Expr(){}
+	static bool classof(const decafAST *n) { return n->getKind() >= FirstExprKind && n->getKind() <= LastExprKind; }
+	decafStmtList *getRvalue(){ return rvalue; }
+	MethodCallAST *getCall(){ return method_call_list; }
+	int getInt(){ return iValue; }
+	bool getBool(){ return bValue; }
+	BinaryOperator *getBinaryOp(){ return bOp; }
+	UnaryOperator *getUnaryOp(){ return uOp; }
+	Expr *getLHS(){ return left_value; }
+	Expr *getRHS(){ return right_value; }
+	Expr *getOperand(){ return value; }
+	// the constant folder replaces operands with their folded form
+	void setLHS(Expr *e){ left_value = e; }
+	void setRHS(Expr *e){ right_value = e; }
+	void setOperand(Expr *e){ value = e; }
+	// the type of the value, filled in by the type checker
+	DecafType getType(){ return type; }
+	void setType(DecafType t){ type = t; }
+	void print(ostream &os) {
+		switch(getKind()){
+		case RvalueExprNode:
+			printNode(os, rvalue);
+			break;
+		case CallExprNode:
+			printNode(os, method_call_list);
+			break;
+		case BinaryExprNode:
+			os << "BinaryExpr(";
+			printNode(os, bOp);
+			os << ',';
+			printNode(os, left_value);
+			os << ',';
+			printNode(os, right_value);
+			os << ')';
+			break;
+		case UnaryExprNode:
+			os << "UnaryExpr(";
+			printNode(os, uOp);
+			os << ',';
+			printNode(os, value);
+			os << ')';
+			break;
+		case IntExprNode:
+			os << "NumberExpr(" << iValue << ")";
+			break;
+		default:
+			os << "BoolExpr(" << (bValue ? "True" : "False") << ")";
 		}
-		else if(bOp != NULL){
-			ret_str = string("BinaryExpr") + "(" + getString(bOp) + "," + getString(left_value) + ","+ getString(right_value) + ")";
-		}
-		else if(uOp != NULL){
-			ret_str = string("UnaryExpr") + "(" + getString(uOp) + "," + getString(value) + ")";
-		}
-		else if(iValue != -1){
-			std::ostringstream stream;
-			stream << "NumberExpr(" << iValue << ")";
-			ret_str = stream.str(); 
-		}
-		else{
-			string bValue_str;
-			if(bValue == true){
-				bValue_str = "True";
-			}else{
-				bValue_str = "False";
-			}
-			std::ostringstream stream;
-			stream << "BoolExpr(" << bValue_str << ")";
-			ret_str = stream.str();
+	}
+	void write(ast_writer &w) {
+		w.kind(getKind());
+		switch(getKind()){
+		case RvalueExprNode:
+			writeNode(w, rvalue);
+			break;
+		case CallExprNode:
+			writeNode(w, method_call_list);
+			break;
+		case BinaryExprNode:
+			writeNode(w, bOp);
+			writeNode(w, left_value);
+			writeNode(w, right_value);
+			break;
+		case UnaryExprNode:
+			writeNode(w, uOp);
+			writeNode(w, value);
+			break;
+		case IntExprNode:
+			w.signed_number(iValue);
+			break;
+		default:
+			w.number(bValue);
 		}
-		return ret_str;
 	}
 
-	llvm::Value *Codegen() {
-		if(bOp != NULL){
+	llvm::Value *Codegen(codegen_context &cx) {
+		switch(getKind()){
+		case BinaryExprNode: {
 			llvm::Value *L;
 			llvm::Value *R;
 
-			if(getString(bOp) == "Or"){
-				llvm::Function *TheFunction = Builder.GetInsertBlock()->getParent();
-				llvm::BasicBlock *scstartBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "scstart", TheFunction);
-				llvm::BasicBlock *sctrueBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "sctrue", TheFunction);
-				llvm::BasicBlock *scfalseBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "scfalse", TheFunction);
-				llvm::BasicBlock *scphiBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "scphi", TheFunction);
-				llvm::BasicBlock *endBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "end", TheFunction);
-
-			// scstart block
-				Builder.CreateBr(scstartBB);
-				Builder.SetInsertPoint(scstartBB);
-
-				L = left_value->Codegen();
-				llvm::Value *trueVal = Builder.getInt1(1);
-				llvm::Value *brCondV = Builder.CreateICmpEQ(L,trueVal,"eqtmp");
-				Builder.CreateCondBr(brCondV, sctrueBB, scfalseBB);
-
-			// sctrue block
-				Builder.SetInsertPoint(sctrueBB);
-				// store L in tmp 
-				Builder.CreateBr(scphiBB);
-
-			// scfalse block
-				Builder.SetInsertPoint(scfalseBB);
-				R = right_value->Codegen();
-				llvm::Value *opval = Builder.CreateOr(L, R, "ortmp");
-				Builder.CreateBr(scphiBB);
-			
-			// phi block
-				Builder.SetInsertPoint(scphiBB);
-
-				llvm::PHINode *val = Builder.CreatePHI(L->getType(), 2, "phival");
-				val->addIncoming(L,sctrueBB);
-				val->addIncoming(opval, scfalseBB);
-
-				Builder.CreateBr(endBB);
-			
-			// end block??
-				Builder.SetInsertPoint(endBB);
-				return val;
-
-			}else if(getString(bOp) == "And"){
-				llvm::Function *TheFunction = Builder.GetInsertBlock()->getParent();
-				llvm::BasicBlock *scstartBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "scstart", TheFunction);
-				llvm::BasicBlock *sctrueBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "sctrue", TheFunction);
-				llvm::BasicBlock *scfalseBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "scfalse", TheFunction);
-				llvm::BasicBlock *scphiBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "scphi", TheFunction);
-				llvm::BasicBlock *endBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "end", TheFunction);
-
-			// scstart block
-				Builder.CreateBr(scstartBB);
-				Builder.SetInsertPoint(scstartBB);
-
-				L = left_value->Codegen();
-				llvm::Value *trueVal = Builder.getInt1(0);
-				llvm::Value *brCondV = Builder.CreateICmpEQ(L,trueVal,"eqtmp");
-				Builder.CreateCondBr(brCondV, sctrueBB, scfalseBB);
-
-			// sctrue block
-				Builder.SetInsertPoint(sctrueBB);
-				// store L in tmp 
-				Builder.CreateBr(scphiBB);
-
-			// scfalse block
-				Builder.SetInsertPoint(scfalseBB);
-				R = right_value->Codegen();
-				llvm::Value *opval = Builder.CreateAnd(L, R, "andtmp");
-				Builder.CreateBr(scphiBB);
-			
-			// phi block
-				Builder.SetInsertPoint(scphiBB);
-
-				llvm::PHINode *val = Builder.CreatePHI(L->getType(), 2, "phival");
-				val->addIncoming(L,sctrueBB);
-				val->addIncoming(opval, scfalseBB);
-
-				Builder.CreateBr(endBB);
-			
-			// end block??
-				Builder.SetInsertPoint(endBB);
-				return val;
-
+			if(bOp->getOp() == And || bOp->getOp() == Or){
+				return shortCircuit(cx);
 			}else{
-				L = left_value -> Codegen();
-				R = right_value -> Codegen();	
-			
-				if (getString(bOp) == "Plus"){
-					return Builder.CreateAdd(L, R, "addtmp");
-				}
-				else if(getString(bOp) == "Minus"){
-					return Builder.CreateSub(L, R, "subtmp");
-				}
-				else if(getString(bOp) == "Mult"){
-					return Builder.CreateMul(L, R, "multmp");
-				}
-				else if(getString(bOp) == "Div"){
-					return Builder.CreateSDiv(L, R, "divtmp");
-				}
-				else if(getString(bOp) == "Leftshift"){
-					return Builder.CreateShl(L, R, "shltmp");
-				}
-				else if(getString(bOp) == "Rightshift"){
-					return Builder.CreateLShr(L, R, "lshrtmp");
-				}
-				else if(getString(bOp) == "Mod"){
-					return Builder.CreateSRem(L, R, "modtmp");
-				}
-				else if(getString(bOp) == "Lt"){
-					return Builder.CreateICmpSLT(L, R, "lcmptmp");
-				}
-				else if(getString(bOp) == "Gt"){
-					return Builder.CreateICmpSGT(L, R, "gcmptmp");
-				}
-				else if(getString(bOp) == "Leq"){
-					return Builder.CreateICmpSLE(L, R, "lecmptmp");
-				}
-				else if(getString(bOp) == "Geq"){
-					return Builder.CreateICmpSGE(L, R, "gecmptmp");
-				}
-				else if(getString(bOp) == "And"){ //////////////////////////////////////////DELETE AFTER SHORT CIRCUITING DONE
-					return Builder.CreateAnd(L, R, "andtmp");
-				}
-				else if(getString(bOp) == "Or"){ //////////////////////////////////////////DELETE AFTER SHORT CIRCUITING DONE
-					return Builder.CreateOr(L, R, "ortmp");
-				}
-				else if(getString(bOp) == "Eq"){
-					return Builder.CreateICmpEQ(L, R, "eqtmp");
-				}
-				else if(getString(bOp) == "Neq"){
-					return Builder.CreateICmpNE(L, R, "cmpnetmp");
-				}
-				else{
-					throw runtime_error("Unsupported Binary Operator " + getString(bOp));
+				L = left_value -> Codegen(cx);
+				R = right_value -> Codegen(cx);	
+
+				const binop_lowering &b = binops[bOp->getOp()];
+				if(b.compare){
+					return cx.Builder.CreateICmp((llvm::CmpInst::Predicate) b.opcode, L, R, b.tmp);
 				}
+				return cx.Builder.CreateBinOp((llvm::Instruction::BinaryOps) b.opcode, L, R, b.tmp);
 			}
 		}
-		else if(uOp != NULL){
-			llvm::Value *U = value -> Codegen();
-			if(getString(uOp) == "UnaryMinus"){
-				return Builder.CreateNeg(U, "negtemp");
-			}
-			else if(getString(uOp) == "Not"){
-				return Builder.CreateNot(U, "notmp");
+		case UnaryExprNode: {
+			llvm::Value *U = value -> Codegen(cx);
+			if(uOp->getOp() == UnaryMinus){
+				return cx.Builder.CreateNeg(U, "negtemp");
 			}
-			else{
-				throw runtime_error("Unsupported Unary Operator " + getString(uOp));
-			}
-		}
-		else if(rvalue != NULL){
-			llvm::Value *R = rvalue -> Codegen();
-			return R;
+			return cx.Builder.CreateNot(U, "notmp");
 		}
-		else if(method_call_list != NULL){
-			llvm::Value *M = method_call_list -> Codegen();
-			return M;
+		case RvalueExprNode:
+			return rvalue -> Codegen(cx);
+		case CallExprNode:
+			return method_call_list -> Codegen(cx);
+		case IntExprNode:
+			return llvm::ConstantInt::get(cx.getContext(), llvm::APInt(32, iValue));
+		default:
+			return llvm::ConstantInt::get(cx.getContext(), llvm::APInt(1, bValue));
 		}
-		else if(iValue != -1){ 		//Bool and Int values need codegen functions still
-			return llvm::ConstantInt::get(llvm::getGlobalContext(), llvm::APInt(32, iValue));
-		}
-		else{
-			return llvm::ConstantInt::get(llvm::getGlobalContext(), llvm::APInt(1, bValue));
+	}
+
+	// branch - lower a condition straight to control flow: jump to t when
+	// it holds and to f when it does not. && and || jump to their targets
+	// without first making an i1, and ! swaps them. The caller seals t and
+	// f once every branch into them exists.
+	void branch(codegen_context &cx, llvm::BasicBlock *t, llvm::BasicBlock *f){
+		if(getKind() == BoolExprNode){
+			cx.Builder.CreateBr(bValue ? t : f);
+		}else if(getKind() == UnaryExprNode && uOp->getOp() == Not){
+			value->branch(cx, f, t);
+		}else if(getKind() == BinaryExprNode && (bOp->getOp() == And || bOp->getOp() == Or)){
+			llvm::Function *TheFunction = cx.Builder.GetInsertBlock()->getParent();
+			llvm::BasicBlock *rhsBB = llvm::BasicBlock::Create(cx.getContext(), bOp->getOp() == And ? "andrhs" : "orrhs", TheFunction);
+			if(bOp->getOp() == And)
+				left_value->branch(cx, rhsBB, f);
+			else
+				left_value->branch(cx, t, rhsBB);
+			cx.ssa.seal(rhsBB);
+			cx.Builder.SetInsertPoint(rhsBB);
+			right_value->branch(cx, t, f);
+		}else{
+			cx.Builder.CreateCondBr(Codegen(cx), t, f);
 		}
 	}
+
+	// pure - whether the expression can be evaluated early, or not at
+	// all, without changing what the program does: no calls, and no
+	// division or array access that could trap
+	bool pure();
+
+private:
+	// && and || as a value. A pure right side is evaluated whatever the
+	// left side is, and the left side selects the result with no branches.
+	// A select rather than an and/or, because the right side may be poison
+	// (a shift by 32 or more) where it should not have run. Otherwise the
+	// left side picks between its own value and the right side's, merged
+	// in one phi.
+	llvm::Value *shortCircuit(codegen_context &cx){
+		bool isAnd = bOp->getOp() == And;
+		llvm::Value *L = left_value->Codegen(cx);
+		if(right_value->pure()){
+			llvm::Value *R = right_value->Codegen(cx);
+			if(isAnd)
+				return cx.Builder.CreateSelect(L, R, cx.Builder.getFalse(), "andtmp");
+			return cx.Builder.CreateSelect(L, cx.Builder.getTrue(), R, "ortmp");
+		}
+		llvm::Function *TheFunction = cx.Builder.GetInsertBlock()->getParent();
+		llvm::BasicBlock *lhsBB = cx.Builder.GetInsertBlock();
+		llvm::BasicBlock *rhsBB = llvm::BasicBlock::Create(cx.getContext(), isAnd ? "andrhs" : "orrhs", TheFunction);
+		llvm::BasicBlock *endBB = llvm::BasicBlock::Create(cx.getContext(), "scend", TheFunction);
+		if(isAnd)
+			cx.Builder.CreateCondBr(L, rhsBB, endBB);
+		else
+			cx.Builder.CreateCondBr(L, endBB, rhsBB);
+		cx.ssa.seal(rhsBB);
+
+		cx.Builder.SetInsertPoint(rhsBB);
+		llvm::Value *R = right_value->Codegen(cx);
+		// the right side may have ended in blocks of its own
+		rhsBB = cx.Builder.GetInsertBlock();
+		cx.Builder.CreateBr(endBB);
+		cx.ssa.seal(endBB);
+
+		cx.Builder.SetInsertPoint(endBB);
+		llvm::PHINode *val = cx.Builder.CreatePHI(llvmType(type, cx), 2, "phival");
+		val->addIncoming(L, lhsBB);
+		val->addIncoming(R, rhsBB);
+		return val;
+	}
 };
 
 
@@ -788,136 +797,147 @@ class FieldSize : public decafAST{
 	DecafTypeAST *type;
 	int size;
 public: 
-	FieldSize(){}
-	FieldSize(int arraySize, DecafTypeAST *t){size = arraySize; type = t;}
+	FieldSize() : decafAST(FieldSizeNode), type(NULL), size(0) {}
+	FieldSize(int arraySize, DecafTypeAST *t) : decafAST(FieldSizeNode) {size = arraySize; type = t;}
 	~FieldSize(){}
-	string str() { 
+	static bool classof(const decafAST *n) { return n->getKind() == FieldSizeNode; }
+	void print(ostream &os) { 
 		if(type == NULL){
-			return string("Scalar");
+			os << "Scalar";
 		}else{
-			std::ostringstream stream;
-			stream << "Array(" << size << ")";
-			string ret_str = stream.str();
-			return ret_str;	
+			os << "Array(" << size << ")";
 		}
 	}
+	void write(ast_writer &w) { 
+		w.kind(FieldSizeNode);
+		writeNode(w, type);
+		w.signed_number(size);
+	}
 	DecafTypeAST* getType(){ return type; }
 	int getSize(){ return size; }
-	llvm::Value *Codegen(){ return 0; };
+	bool isScalar(){ return type == NULL; }
+	llvm::Value *Codegen(codegen_context &cx){ return 0; };
 };
 
 class FieldDeclAST : public decafAST {
-	string name;
+	atom name;
 	DecafTypeAST *type;
 	FieldSize *fieldSize;
 	Expr *value;
+	source_range range;
 
 public:
-    FieldDeclAST(string n, DecafTypeAST *t, FieldSize *fs) : name(n), fieldSize(fs) {type = t;}
-    FieldDeclAST(string n, DecafTypeAST *t, Expr *v) : name(n){ type = t; value = v; fieldSize = NULL; }
+    FieldDeclAST(atom n, DecafTypeAST *t, FieldSize *fs) : decafAST(FieldDeclNode), name(n), fieldSize(fs) {type = t; value = NULL;}
+    FieldDeclAST(atom n, DecafTypeAST *t, Expr *v) : decafAST(FieldDeclNode), name(n){ type = t; value = v; fieldSize = NULL; }
     ~FieldDeclAST() {}
-    string str() { 
-    	string ret_str;
+    static bool classof(const decafAST *n) { return n->getKind() == FieldDeclNode; }
+    void print(ostream &os) { 
+    	os << (fieldSize != NULL ? "FieldDecl(" : "AssignGlobalVar(") << atoms.spelling(name) << ',';
+    	printNode(os, type);
+    	os << ',';
+    	if(fieldSize != NULL){
+    		printNode(os, fieldSize);
+    	}else{
+    		printNode(os, value);
+    	}
+    	os << ')';
+    }
+    void write(ast_writer &w) { 
+    	w.kind(FieldDeclNode);
+    	w.name(name);
+    	writeNode(w, type);
+    	w.number(fieldSize == NULL);
     	if(fieldSize != NULL){
-    		ret_str = string("FieldDecl(") + name + "," + getString(type) + "," + getString(fieldSize) + ")";	
+    		writeNode(w, fieldSize);
     	}else{
-    		ret_str = string("AssignGlobalVar(") + name + "," + getString(type) + "," + getString(value) + ")";	
+    		writeNode(w, value);
     	}
-    	return ret_str;
+    	w.range(range);
     }
-    llvm::Value *Codegen(){ 
+    llvm::Value *Codegen(codegen_context &cx){ 
 
     	llvm::GlobalVariable *globVar;
 
     // FIELD DECL 
     	if(fieldSize != NULL){
     	//  CHECK IF SCALAR OR ARRAY
-    		if(getString(fieldSize)=="Scalar"){
+    		if(fieldSize->isScalar()){
     	// IF SCALAR
     		// Type & Zero Init
-    			string typeStr = getString(type);
-    			llvm::Type *t;
-    			llvm::ConstantInt *val;
-    			if(typeStr == "int"){
-    				t = Builder.getInt32Ty();
-    				val = Builder.getInt32(0);
-    			}else if(typeStr == "bool"){
-    				t = Builder.getInt1Ty();
-    				val = Builder.getInt1(0);
-    			}
+    			llvm::Type *t = llvmType(type->getType(), cx);
+    			llvm::Constant *val = llvm::Constant::getNullValue(t);
     		// Declare
     			globVar = new llvm::GlobalVariable(
-    				*TheModule
+    				*cx.TheModule
     				, t
     				, false
     				, llvm::GlobalValue::InternalLinkage
     				, val
-    				, name
+    				, atoms.spelling(name)
     			);
 
     		}else{
     	// IF GLOBAL ARRAY
     		// Type / Size
 				int size = fieldSize->getSize();
-				string typeStr = getString(type);
-				llvm::ArrayType *arrType;
-				if(typeStr == "int"){
-					arrType = llvm::ArrayType::get(Builder.getInt32Ty(), size);
-				}else if(typeStr == "bool"){
-					arrType = llvm::ArrayType::get(Builder.getInt1Ty(), size);
-				}
+				llvm::ArrayType *arrType = llvm::ArrayType::get(llvmType(type->getType(), cx), size);
 			// Zero Initialize
 				llvm::Constant *zeroInit = llvm::Constant::getNullValue(arrType);
 			// Declare Global Arr
 				globVar = new llvm::GlobalVariable(
-					*TheModule
+					*cx.TheModule
 					, arrType
 					, false
 					, llvm::GlobalValue::ExternalLinkage
 					, zeroInit
-					, name
+					, atoms.spelling(name)
 				);
-
-			// Add to symbol table
-				enter_symtbl(name, globVar);
     		}
 
 
     // ASSIGN GLOBAL VAR
     	}else{
-    		string typeStr = getString(type);
-    		llvm::Type *t;
-			if(typeStr == "int"){
-				t = Builder.getInt32Ty();
-			}else if(typeStr == "bool"){
-				t = Builder.getInt1Ty();
-			}
+    		llvm::Type *t = llvmType(type->getType(), cx);
 
-    		llvm::ConstantInt *val = (llvm::ConstantInt*) (value->Codegen());
+    		llvm::ConstantInt *val = (llvm::ConstantInt*) (value->Codegen(cx));
 
     		globVar = new llvm::GlobalVariable(
-    			*TheModule
+    			*cx.TheModule
     			, t
     			, false
     			, llvm::GlobalValue::InternalLinkage
     			, val
-    			, name
+    			, atoms.spelling(name)
     		);
-
-    		enter_symtbl(name, globVar);
     	}
 
-
+    	cx.decls[this] = globVar;
+    	return globVar;
     };
+    // the type of the global: the element type, or an array of them
+    llvm::Type *valueType(codegen_context &cx){
+    	llvm::Type *t = llvmType(type->getType(), cx);
+    	if(fieldSize != NULL && !fieldSize->isScalar())
+    		return llvm::ArrayType::get(t, fieldSize->getSize());
+    	return t;
+    }
+    atom getName(){ return name; }
+    DecafTypeAST *getType(){ return type; }
+    FieldSize *getFieldSize(){ return fieldSize; }
+    Expr *getValue(){ return value; }
+    source_range getRange(){ return range; }
+    void setRange(source_range r){ range = r; }
 };
 
 class MethodArg : public decafAST {
 	string value;
+	atom literal;
 	Expr *expr = NULL;
 public:
-	MethodArg(string v) { 
-		int len = v.size();
-		string s = v.substr(1, len-2);
+	MethodArg(atom v) : decafAST(MethodArgNode), literal(v) { 
+		const string &lit = atoms.spelling(v);
+		int len = lit.size();
+		string s = lit.substr(1, len-2);
 		
 		vector<char> charVec;
 		for(int i=0; i<s.size();i++){
@@ -952,28 +972,40 @@ public:
 		}
 		value = string(charVec.begin(), charVec.end());
 	}
-	MethodArg(Expr *e) : expr(e) {}
-	~MethodArg() { if(expr != NULL) { delete expr; } }
-	string str(){
-		string ret_str;
+	MethodArg(Expr *e) : decafAST(MethodArgNode), expr(e) {}
+	~MethodArg() {}
+	static bool classof(const decafAST *n) { return n->getKind() == MethodArgNode; }
+	Expr *getExpr(){ return expr; }
+	void setExpr(Expr *e){ expr = e; }
+	const string &getValue(){ return value; }
+	void print(ostream &os){
 		if(expr != NULL){
-			ret_str = getString(expr);
+			printNode(os, expr);
 		}
 		else{
-			ret_str = string("StringConstant") + "(" + value + ")";
+			os << "StringConstant(" << value << ")";
+		}
+	}
+	void write(ast_writer &w){
+		w.kind(MethodArgNode);
+		w.number(expr == NULL);
+		if(expr != NULL){
+			writeNode(w, expr);
+		}
+		else{
+			w.name(literal);
 		}
-		return ret_str;
 	}
 
-	llvm::Value *Codegen(){
+	llvm::Value *Codegen(codegen_context &cx){
 		if(expr != NULL){
-			llvm::Value *E = expr -> Codegen();
+			llvm::Value *E = expr -> Codegen(cx);
 			return E;
 		}
 		else{
 			//Value CodeGen needs to be completed here
-			llvm::GlobalVariable *GS = Builder.CreateGlobalString(value, "globalstring");
-			llvm::Value *stringConst = Builder.CreateConstGEP2_32(GS->getValueType(), GS, 0, 0, "cast");
+			llvm::GlobalVariable *GS = cx.Builder.CreateGlobalString(value, "globalstring");
+			llvm::Value *stringConst = cx.Builder.CreateConstGEP2_32(GS->getValueType(), GS, 0, 0, "cast");
 			return stringConst;
 		}
 	}
@@ -984,16 +1016,30 @@ class MethodBlock : public decafAST{
 	decafStmtList *var_decl_list; // typed_symbol*
 	decafStmtList *statement_list; // statement*
 public:
-	MethodBlock(decafStmtList *vdl, decafStmtList *sl){ var_decl_list = vdl; statement_list = sl; }
-	~MethodBlock(){ if(var_decl_list != NULL) {delete var_decl_list;} if(statement_list != NULL) {delete statement_list;} }
-	string str(){ return string("MethodBlock") + '(' + getString(var_decl_list) + ',' + getString(statement_list) + ')'; }
-	llvm::Value *Codegen(){ 
+	MethodBlock(decafStmtList *vdl, decafStmtList *sl) : decafAST(MethodBlockNode) { var_decl_list = vdl; statement_list = sl; }
+	~MethodBlock(){}
+	static bool classof(const decafAST *n) { return n->getKind() == MethodBlockNode; }
+	decafStmtList *getVars(){ return var_decl_list; }
+	decafStmtList *getStmts(){ return statement_list; }
+	void print(ostream &os){
+		os << "MethodBlock(";
+		printNode(os, var_decl_list);
+		os << ',';
+		printNode(os, statement_list);
+		os << ')';
+	}
+	void write(ast_writer &w){
+		w.kind(MethodBlockNode);
+		writeNode(w, var_decl_list);
+		writeNode(w, statement_list);
+	}
+	llvm::Value *Codegen(codegen_context &cx){ 
 		llvm::Value *val = NULL;
 		if(var_decl_list!=NULL){
-			val = var_decl_list->Codegen();	
+			val = var_decl_list->Codegen(cx);	
 		}
 		if( statement_list != NULL){
-			val = statement_list->Codegen();	
+			val = statement_list->Codegen(cx);	
 		}
 		
 		return val;
@@ -1001,213 +1047,269 @@ public:
 };
 
 class MethodDecl : public decafAST{
-	string name;
+	atom name;
 	MethodTypeAST *return_type;
 	decafStmtList *param_list; //typed_symbol
 	MethodBlock *block;
+	source_range body;
 public:
-	MethodDecl(string n, MethodTypeAST *rt, decafStmtList *pl, MethodBlock *b){ name = n; return_type = rt;	param_list = pl; block = b; }
-	~MethodDecl(){delete return_type; delete param_list; delete block; }
-	string str(){ return string("Method(") + name.c_str() + "," + getString(return_type) + "," + getString(param_list) + "," + getString(block) + ")" ; }
-	llvm::Value *proto(){
-		syms.new_symtbl();
-
-		llvm::Type *returnTy;
-		string ret_str = return_type->str();
-		if(ret_str == "VoidType"){
-			returnTy = Builder.getVoidTy();
-		}else if(ret_str == "IntType"){
-			returnTy = Builder.getInt32Ty();
-		}else if(ret_str == "BoolType"){
-			returnTy = Builder.getInt1Ty();
-		}
+	MethodDecl(atom n, MethodTypeAST *rt, decafStmtList *pl, MethodBlock *b) : decafAST(MethodDeclNode) { name = n; return_type = rt;	param_list = pl; block = b; }
+	~MethodDecl(){}
+	static bool classof(const decafAST *n) { return n->getKind() == MethodDeclNode; }
+	atom getName(){ return name; }
+	MethodTypeAST *getReturnType(){ return return_type; }
+	decafStmtList *getParams(){ return param_list; }
+	MethodBlock *getBlock(){ return block; }
+	void print(ostream &os){
+		os << "Method(" << atoms.spelling(name) << ',';
+		printNode(os, return_type);
+		os << ',';
+		printNode(os, param_list);
+		os << ',';
+		printNode(os, block);
+		os << ')';
+	}
+	void write(ast_writer &w){
+		w.kind(MethodDeclNode);
+		w.name(name);
+		writeNode(w, return_type);
+		writeNode(w, param_list);
+		writeNode(w, block);
+		w.range(body);
+	}
+	llvm::FunctionType *functionType(codegen_context &cx){
+		llvm::Type *returnTy = llvmType(return_type->getType(), cx);
 
 		std::vector<llvm::Type *> args;
-		list<decafAST *> argASTList = param_list->getList();
-		for(typename list<decafAST *>::iterator i = argASTList.begin(); i != argASTList.end(); i++){
-			TypedSymbolAST *ts = (TypedSymbolAST *) *i;
-			if(ts->getTypeStr()=="int"){
-				args.push_back(Builder.getInt32Ty());
-			}else if(ts->getTypeStr()=="bool"){
-				args.push_back(Builder.getInt1Ty());
-			}
+		llvm::ArrayRef<decafAST *> argASTList = param_list->getList();
+		for(llvm::ArrayRef<decafAST *>::iterator i = argASTList.begin(); i != argASTList.end(); i++){
+			TypedSymbolAST *ts = llvm::cast<TypedSymbolAST>(*i);
+			args.push_back(llvmType(ts->getType(), cx));
 		}
 
-		llvm::FunctionType *FT;
 		if(args.size()==0){
-			 FT = llvm::FunctionType::get(returnTy, false);	
-		}else{
-			FT = llvm::FunctionType::get(returnTy, args, false);
+			return llvm::FunctionType::get(returnTy, false);	
 		}
-
+		return llvm::FunctionType::get(returnTy, args, false);
+	}
+	llvm::Value *proto(codegen_context &cx){
 		llvm::Function *func = llvm::Function::Create(
-			FT,
+			functionType(cx),
 			llvm::Function::ExternalLinkage,
-			name,
-			TheModule
+			atoms.spelling(name),
+			cx.TheModule
 		);
-    	syms.remove_symtbl();
-
-		enter_symtbl(name, func);
+		cx.decls[this] = func;
 
 		return func;
 
 	}
-	llvm::Value *Codegen(){
-		syms.new_symtbl();
-		llvm::Function *func = (llvm::Function *)syms.access_symtbl(name)->getVal();
-
-		llvm::Type *returnTy = (llvm::Type *)return_type->Codegen();			//have to get return type of function here
-		
-		//std::vector<llvm::Type *> args = param_list->getMethodParamTypes();	//have to get list of function args here
-		std::vector<llvm::Type *> args;
-		list<decafAST *> argASTList = param_list->getList();
-		for(typename list<decafAST *>::iterator i = argASTList.begin(); i != argASTList.end(); i++){
-			TypedSymbolAST *ts = (TypedSymbolAST *) *i;
-			if(ts->getTypeStr()=="int"){
-				args.push_back(Builder.getInt32Ty());
-			}else if(ts->getTypeStr()=="bool"){
-				args.push_back(Builder.getInt1Ty());
-			}
-		}
+	source_range getBodyRange(){ return body; }
+	void setBodyRange(source_range r){ body = r; }
+	llvm::Value *Codegen(codegen_context &cx){
+		// proto() made the function in the main module; a shard being
+		// generated on another thread declares its own copy
+		llvm::Function *func = llvm::cast<llvm::Function>(declValue(this, cx));
+		llvm::ArrayRef<decafAST *> argASTList = param_list->getList();
 
-		llvm::FunctionType *FT;
-		if(args.size()==0){
-			 FT = llvm::FunctionType::get(returnTy, false);	
-		}else{
-			FT = llvm::FunctionType::get(returnTy, args, false);
-		}
-
-		if(func == NULL){
-			func = llvm::Function::Create(
-				FT,
-				llvm::Function::ExternalLinkage,
-				name,
-				TheModule
-			);
-		}
-
-		// Get all args of TypedSymbolAST
-		std::vector<string> names;
-		for(typename list<decafAST *>::iterator i = argASTList.begin(); i != argASTList.end(); i++){
-			TypedSymbolAST *ts = (TypedSymbolAST *) *i;
-			names.push_back(ts->getName());
-		}
-		
 		//// Set names for all arguments ////
 		
 		int Idx = 0;
 		for (auto &Arg : func->args())
-    		Arg.setName(names[Idx++]);
+    		Arg.setName(atoms.spelling(llvm::cast<TypedSymbolAST>(argASTList[Idx++])->getName()));
 
 		//// Basic Block //////////		
 
-		llvm::BasicBlock *BB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "entry", func);
-		Builder.SetInsertPoint(BB);
+		llvm::BasicBlock *BB = llvm::BasicBlock::Create(cx.getContext(), "entry", func);
+		cx.Builder.SetInsertPoint(BB);
+		cx.frame.begin(BB);
+		cx.bounds.begin();
+		cx.ssa.clear();
+		cx.ssa.seal(BB);
 
 		// Extra variable creation////////////////////////////////////
 		llvm::AllocaInst *Alloca;
+		Idx = 0;
 		for (auto &Arg : func->args()) {
-			 Alloca = Builder.CreateAlloca(Arg.getType(), nullptr, Arg.getName());
+			if(cx.ssa.enabled){
+				cx.ssa.declare(argASTList[Idx], Arg.getType(), Arg.getName().str());
+				cx.ssa.define(argASTList[Idx++], BB, &Arg);
+				continue;
+			}
+			Alloca = cx.frame.allocate(Arg.getType(), Arg.getName().str(), cx.Builder);
 
-			Builder.CreateStore(&Arg, Alloca);
-			enter_symtbl(Arg.getName(), Alloca);
+			cx.Builder.CreateStore(&Arg, Alloca);
+			cx.decls[argASTList[Idx++]] = Alloca;
 		}
 		///////////////////////////////////////////////////
 
-		llvm::Value *blockRetVal = block->Codegen();
+		llvm::Value *blockRetVal = block->Codegen(cx);
 
 		// COMPARE RETURN TYPES//////////////////////////////////////////
 		// Return Type
 		llvm::Type *retType = func->getReturnType();
 		llvm::Value *defaultRetVal;
 
-		if(getString(return_type)=="VoidType" && defaultRet == true){
-			defaultRetVal = Builder.CreateRetVoid();
-		}else if(getString(return_type)=="IntType" && defaultRet == true){
-			defaultRetVal = Builder.CreateRet(llvm::ConstantInt::get(llvm::getGlobalContext(), llvm::APInt(32, 0)));
-		}else if(getString(return_type)=="BoolType" && defaultRet == true){
-			defaultRetVal = Builder.CreateRet(llvm::ConstantInt::get(llvm::getGlobalContext(), llvm::APInt(1, 1)));
+		if(return_type->getType() == VoidType && cx.defaultRet == true){
+			defaultRetVal = cx.Builder.CreateRetVoid();
+		}else if(return_type->getType() == IntType && cx.defaultRet == true){
+			defaultRetVal = cx.Builder.CreateRet(llvm::ConstantInt::get(cx.getContext(), llvm::APInt(32, 0)));
+		}else if(return_type->getType() == BoolType && cx.defaultRet == true){
+			defaultRetVal = cx.Builder.CreateRet(llvm::ConstantInt::get(cx.getContext(), llvm::APInt(1, 1)));
 		}
 
 		///////////////////////////////////////////////////////////////
 		
-		defaultRet = true;
-		syms.remove_symtbl();
-		enter_symtbl(name, func);
+		cx.defaultRet = true;
 
 		return func;
 	}
 };
 
 
+static llvm::Value *elementAddress(decafAST *binding, Expr *index, codegen_context &cx);
+
 class Rvalue : public decafAST {
-	string name;
-	Expr *index;
+	atom name;
+	Expr *index = NULL;
+	decafAST *binding = NULL;
+	DecafType type = VoidType;
 public:
-	Rvalue(string n) : name(n) {}
-	Rvalue(string n, Expr *e) : name(n), index(e) {}
-	~Rvalue() { if(index != NULL) { delete index; } }
-	string ret_str;
-	string str() {
+	Rvalue(atom n) : decafAST(RvalueNode), name(n) {}
+	Rvalue(atom n, Expr *e) : decafAST(RvalueNode), name(n), index(e) {}
+	~Rvalue() {}
+	static bool classof(const decafAST *n) { return n->getKind() == RvalueNode; }
+	atom getName(){ return name; }
+	Expr *getIndex(){ return index; }
+	void setIndex(Expr *e){ index = e; }
+	// the TypedSymbolAST or FieldDeclAST the name resolves to
+	decafAST *getBinding(){ return binding; }
+	void setBinding(decafAST *d){ binding = d; }
+	// the type of the variable, or of one element of an array, filled in
+	// by the type checker
+	DecafType getType(){ return type; }
+	void setType(DecafType t){ type = t; }
+	void print(ostream &os) {
 		if(index != NULL){
-			ret_str = string("ArrayLocExpr") + "(" + name + "," + getString(index) + ")"; 
+			os << "ArrayLocExpr(" << atoms.spelling(name) << ',';
+			printNode(os, index);
+			os << ')';
 		}else{
-			ret_str = string("VariableExpr") + "(" + name + ")";
+			os << "VariableExpr(" << atoms.spelling(name) << ')';
 		}
-	return ret_str;
 	}
-	llvm::Value *Codegen(){ 
+	void write(ast_writer &w) {
+		w.kind(RvalueNode);
+		w.name(name);
+		writeNode(w, index);
+	}
+	llvm::Value *Codegen(codegen_context &cx){ 
 		if(index != NULL){
-			throw runtime_error("Array index allocation not supported yet");
+			return cx.Builder.CreateLoad(elementAddress(binding, index, cx), atoms.spelling(name));
+		}else if(cx.ssa.enabled && binding->getKind() == TypedSymbolNode){
+			return cx.ssa.use(binding, cx.Builder.GetInsertBlock());
 		}else{
-			descriptor *d = syms.access_symtbl(name);
-			llvm::Value *v = d->getVal();
-			return Builder.CreateLoad(v,name);
+			llvm::Value *v = declValue(binding, cx);
+			return cx.Builder.CreateLoad(v,atoms.spelling(name));
 
 		}
 	};
 
 };
 
+// elementAddress - the address of element index of the array field
+// binding, after the bounds check the mode calls for. The type checker
+// only lets arrays be indexed; an AST that skipped it gets an error here.
+static llvm::Value *elementAddress(decafAST *binding, Expr *index, codegen_context &cx){
+	FieldDeclAST *f = llvm::dyn_cast<FieldDeclAST>(binding);
+	if(f == NULL || f->getFieldSize() == NULL || f->getFieldSize()->isScalar())
+		throw runtime_error("indexed variable is not an array");
+	llvm::Value *idx = index->Codegen(cx);
+	decafAST *var = NULL;
+	if(index->getKind() == RvalueExprNode){
+		Rvalue *r = llvm::cast<Rvalue>(index->getRvalue()->getList()[0]);
+		if(r->getIndex() == NULL)
+			var = r->getBinding();
+	}
+	if(llvm::BasicBlock *cont = cx.bounds.check(idx, f->getFieldSize()->getSize(), var, cx.Builder))
+		cx.ssa.seal(cont);
+	llvm::Value *indexes[] = { cx.Builder.getInt32(0), idx };
+	return cx.Builder.CreateInBoundsGEP(f->valueType(cx), declValue(binding, cx), indexes, "arrayidx");
+}
+
+bool Expr::pure(){
+	switch(getKind()){
+	case IntExprNode:
+	case BoolExprNode:
+		return true;
+	case RvalueExprNode:
+		return llvm::cast<Rvalue>(rvalue->getList()[0])->getIndex() == NULL;
+	case UnaryExprNode:
+		return value->pure();
+	case BinaryExprNode: {
+		BinaryOp op = bOp->getOp();
+		if(op == Div || op == Mod){
+			if(right_value->getKind() != IntExprNode || right_value->iValue == 0 || right_value->iValue == -1)
+				return false;
+		}
+		return left_value->pure() && right_value->pure();
+	}
+	default:
+		return false;
+	}
+}
+
 class Assign : public decafAST {
-	string name;
+	atom name;
 	Expr *value = NULL;
 	Expr *index = NULL;
+	decafAST *binding = NULL;
 public:
-	Assign(string n, Expr *v) : name(n), value(v) {}
-	Assign(string n, Expr *i, Expr *v) : name(n), index(i), value(v) {}
-	~Assign(){
-		if(value != NULL){ delete value; }
-		if(index != NULL){ delete index; }
-	}
-	string str(){
+	Assign(atom n, Expr *v) : decafAST(AssignNode), name(n), value(v) {}
+	Assign(atom n, Expr *i, Expr *v) : decafAST(AssignNode), name(n), index(i), value(v) {}
+	~Assign(){}
+	static bool classof(const decafAST *n) { return n->getKind() == AssignNode; }
+	atom getName(){ return name; }
+	Expr *getIndex(){ return index; }
+	Expr *getValue(){ return value; }
+	void setIndex(Expr *e){ index = e; }
+	void setValue(Expr *e){ value = e; }
+	// the TypedSymbolAST or FieldDeclAST the name resolves to
+	decafAST *getBinding(){ return binding; }
+	void setBinding(decafAST *d){ binding = d; }
+	void print(ostream &os){
 		if(index == NULL){
-			return string("AssignVar") + "(" + name + "," + getString(value) + ")";
+			os << "AssignVar(" << atoms.spelling(name) << ',';
 		}else
 		{
-			return string("AssignArrayLoc") + "(" + name + "," + getString(index) + "," + getString(value) + ")";
+			os << "AssignArrayLoc(" << atoms.spelling(name) << ',';
+			printNode(os, index);
+			os << ',';
 		}
+		printNode(os, value);
+		os << ')';
 	}
-	llvm::Value *Codegen(){ 
-		if(index==NULL){
-			descriptor *d = syms.access_symtbl(name);
-			if(d==NULL){
-				throw runtime_error("Cannot assign undeclared variable");
-			}
-			llvm::AllocaInst *Alloca = (llvm::AllocaInst *)d->getVal();
+	void write(ast_writer &w){
+		w.kind(AssignNode);
+		w.name(name);
+		writeNode(w, index);
+		writeNode(w, value);
+	}
+	llvm::Value *Codegen(codegen_context &cx){ 
+		if(index==NULL && cx.ssa.enabled && binding->getKind() == TypedSymbolNode){
+			llvm::Value *v = value->Codegen(cx);
+			cx.ssa.define(binding, cx.Builder.GetInsertBlock(), v);
+			return v;
+		}else if(index==NULL){
+			llvm::Value *Alloca = declValue(binding, cx);
 			
-			llvm::Value *v = value->Codegen();
-
-
-			if ( d->getVal()->getType() != v->getType()->getPointerTo() ){
-				throw runtime_error("mismatched type for variable "+name);
-			}
+			llvm::Value *v = value->Codegen(cx);
 
 			//return Builder.CreateStore(value->Codegen(), d->getVal());
-			return Builder.CreateStore(v, Alloca);
+			return cx.Builder.CreateStore(v, Alloca);
 		}else{
-			throw runtime_error("assign array loc not supported");
+			llvm::Value *element = elementAddress(binding, index, cx);
+			return cx.Builder.CreateStore(value->Codegen(cx), element);
 		}
 	}
 };
@@ -1216,31 +1318,39 @@ class Block : public decafAST {
 	decafStmtList *stmt_list = NULL;
 	decafStmtList *var_dec_list = NULL;
 public:
-	Block(decafStmtList *v, decafStmtList *s) : var_dec_list(v), stmt_list(s) {}
-	~Block(){
-		if(stmt_list != NULL){ delete stmt_list; }
-		if(var_dec_list != NULL) { delete var_dec_list; }
+	Block(decafStmtList *v, decafStmtList *s) : decafAST(BlockNode), var_dec_list(v), stmt_list(s) {}
+	~Block(){}
+	static bool classof(const decafAST *n) { return n->getKind() == BlockNode; }
+	decafStmtList *getVars(){ return var_dec_list; }
+	decafStmtList *getStmts(){ return stmt_list; }
+	void print(ostream &os){
+		os << "Block(";
+		printNode(os, var_dec_list);
+		os << ',';
+		printNode(os, stmt_list);
+		os << ')';
 	}
-	string str(){
-		return string("Block") + "(" + getString(var_dec_list) + "," + getString(stmt_list) + ")";
+	void write(ast_writer &w){
+		w.kind(BlockNode);
+		writeNode(w, var_dec_list);
+		writeNode(w, stmt_list);
 	}
-	llvm::Value *Codegen(){ 
-		syms.new_symtbl();
+	llvm::Value *Codegen(codegen_context &cx){ 
 		llvm::Value *val = NULL;
+		cx.frame.open_scope();
 		if(var_dec_list!=NULL){
-			val = var_dec_list->Codegen();	
+			val = var_dec_list->Codegen(cx);	
 		}
 		if( stmt_list != NULL){
-			val = stmt_list->Codegen();	
+			val = stmt_list->Codegen(cx);	
 		}
-		syms.remove_symtbl();
+		cx.frame.close_scope(cx.Builder);
 		return val;
 	};
 
 };
 
 class StatementAST : public decafAST {
-	string state;
 	Assign *assign = NULL;
 	MethodCallAST *methCall = NULL;
 	Block *if_block = NULL;
@@ -1253,200 +1363,521 @@ class StatementAST : public decafAST {
 	Expr *return_value = NULL;
 	Block *block = NULL;
 	decafStmtList *eReturn = NULL;
-	MethodDecl *temp;
+	loop_range range;
 public:
-	StatementAST(Assign *a) : assign(a) {}
-	StatementAST(MethodCallAST *m) : methCall(m) {}
-	StatementAST(Expr *c, Block *i, Block *e) : condition(c), if_block(i), else_block(e) {}
-	StatementAST(Expr *c, Block *w) : condition(c), while_block(w) {}
-	StatementAST(decafStmtList *p, Expr *c, decafStmtList *l, Block* b) : pre_assign_list(p), condition(c), loop_assign_list(l), for_block(b){}
-	StatementAST(Expr *r) : return_value(r) {}
-	StatementAST(Block *b) : block(b) {}
-	StatementAST(string s) : state(s) {}
-	StatementAST(string s, decafStmtList *d) : state(s), eReturn(d) {}
-	~StatementAST(){
-		if(assign != NULL){ delete assign; }
-		if(methCall != NULL){ delete methCall; }
-		if(if_block != NULL){ delete if_block; }
-		if(else_block != NULL){ delete else_block; }
-		if(while_block != NULL){ delete while_block; }
-		if(condition != NULL){ delete condition; }
-		if(pre_assign_list != NULL){ delete pre_assign_list; }
-		if(loop_assign_list != NULL){ delete loop_assign_list; }
-		if(return_value != NULL){ delete return_value; }
-		if(block != NULL){ delete block; }
-		if(eReturn != NULL){ delete eReturn; }
-	}
-	string str(){
-		if(assign != NULL){
-			return getString(assign);
-		}else if(methCall != NULL){
-			return getString(methCall);
-		}else if(condition != NULL && if_block != NULL){
-			return string("IfStmt") + "(" + getString(condition) + "," + getString(if_block) + "," + getString(else_block) + ")";  
-		}else if(condition != NULL && while_block != NULL){
-			return string("WhileStmt") + "(" + getString(condition) + "," + getString(while_block) + ")";
-		}else if(pre_assign_list != NULL && condition != NULL && loop_assign_list != NULL && for_block != NULL){
-			return string("ForStmt") + "(" + getString(pre_assign_list) + "," + getString(condition) + "," + getString(loop_assign_list) + "," + getString(for_block) +")";
-		}else if(return_value != NULL){
-			return string("ReturnStmt") + "(" + getString(return_value) + ")";
-		}else if(state == "break"){
-			return string("BreakStmt");
-		}else if(state == "continue"){
-			return string("ContinueStmt");
-		}else if(block != NULL){
-			return getString(block);
-		}else if(state == "return"){
-			return string("ReturnStmt") + "(" + getString(eReturn) + ")";
+	StatementAST(Assign *a) : decafAST(AssignStmtNode), assign(a) {}
+	StatementAST(MethodCallAST *m) : decafAST(CallStmtNode), methCall(m) {}
+	StatementAST(Expr *c, Block *i, Block *e) : decafAST(IfStmtNode), condition(c), if_block(i), else_block(e) {}
+	StatementAST(Expr *c, Block *w) : decafAST(WhileStmtNode), condition(c), while_block(w) {}
+	StatementAST(decafStmtList *p, Expr *c, decafStmtList *l, Block* b) : decafAST(ForStmtNode), pre_assign_list(p), condition(c), loop_assign_list(l), for_block(b){}
+	StatementAST(Expr *r) : decafAST(ReturnStmtNode), return_value(r) {}
+	StatementAST(Block *b) : decafAST(BlockStmtNode), block(b) {}
+	// BreakStmtNode, ContinueStmtNode, or VoidReturnStmtNode with its empty value list
+	StatementAST(NodeKind k, decafStmtList *d = NULL) : decafAST(k), eReturn(d) {}
+	~StatementAST(){}
+	static bool classof(const decafAST *n) { return n->getKind() >= FirstStmtKind && n->getKind() <= LastStmtKind; }
+	Assign *getAssign(){ return assign; }
+	MethodCallAST *getCall(){ return methCall; }
+	Expr *getCondition(){ return condition; }
+	void setCondition(Expr *e){ condition = e; }
+	Block *getThen(){ return if_block; }
+	Block *getElse(){ return else_block; }
+	// the loop body of a while or for statement
+	Block *getBody(){ return getKind() == WhileStmtNode ? while_block : for_block; }
+	decafStmtList *getInit(){ return pre_assign_list; }
+	decafStmtList *getStep(){ return loop_assign_list; }
+	Expr *getValue(){ return return_value; }
+	void setValue(Expr *e){ return_value = e; }
+	Block *getBlock(){ return block; }
+	decafStmtList *getVoidValue(){ return eReturn; }
+	// the range of a loop's induction variable, filled in by the range finder
+	const loop_range &getRange(){ return range; }
+	void setRange(const loop_range &r){ range = r; }
+	void print(ostream &os){
+		switch(getKind()){
+		case AssignStmtNode:
+			printNode(os, assign);
+			break;
+		case CallStmtNode:
+			printNode(os, methCall);
+			break;
+		case IfStmtNode:
+			os << "IfStmt(";
+			printNode(os, condition);
+			os << ',';
+			printNode(os, if_block);
+			os << ',';
+			printNode(os, else_block);
+			os << ')';
+			break;
+		case WhileStmtNode:
+			os << "WhileStmt(";
+			printNode(os, condition);
+			os << ',';
+			printNode(os, while_block);
+			os << ')';
+			break;
+		case ForStmtNode:
+			os << "ForStmt(";
+			printNode(os, pre_assign_list);
+			os << ',';
+			printNode(os, condition);
+			os << ',';
+			printNode(os, loop_assign_list);
+			os << ',';
+			printNode(os, for_block);
+			os << ')';
+			break;
+		case ReturnStmtNode:
+			os << "ReturnStmt(";
+			printNode(os, return_value);
+			os << ')';
+			break;
+		case BreakStmtNode:
+			os << "BreakStmt";
+			break;
+		case ContinueStmtNode:
+			os << "ContinueStmt";
+			break;
+		case BlockStmtNode:
+			printNode(os, block);
+			break;
+		default:
+			os << "ReturnStmt(";
+			printNode(os, eReturn);
+			os << ')';
 		}
 	}
-	llvm::Value *Codegen(){ 
-		if(assign != NULL){
-			return assign -> Codegen();
-		}
-		else if(methCall != NULL){
-			return methCall -> Codegen();
+	void write(ast_writer &w){
+		w.kind(getKind());
+		switch(getKind()){
+		case AssignStmtNode:
+			writeNode(w, assign);
+			break;
+		case CallStmtNode:
+			writeNode(w, methCall);
+			break;
+		case IfStmtNode:
+			writeNode(w, condition);
+			writeNode(w, if_block);
+			writeNode(w, else_block);
+			break;
+		case WhileStmtNode:
+			writeNode(w, condition);
+			writeNode(w, while_block);
+			break;
+		case ForStmtNode:
+			writeNode(w, pre_assign_list);
+			writeNode(w, condition);
+			writeNode(w, loop_assign_list);
+			writeNode(w, for_block);
+			break;
+		case ReturnStmtNode:
+			writeNode(w, return_value);
+			break;
+		case BlockStmtNode:
+			writeNode(w, block);
+			break;
+		case VoidReturnStmtNode:
+			writeNode(w, eReturn);
+			break;
+		default:
+			break;
 		}
-		else if(block != NULL){
-			return block -> Codegen();
-		}
-		else if(state == "return"){	
-			defaultRet = false;
-			return Builder.CreateRetVoid();
-		}
-		else if(return_value != NULL){
-			llvm::Value *val = return_value -> Codegen();
-			defaultRet = false;
-			return Builder.CreateRet(val);
-		}
-		else if(condition != NULL && while_block != NULL){
+	}
+	llvm::Value *Codegen(codegen_context &cx){ 
+		switch(getKind()){
+		case AssignStmtNode:
+			return assign -> Codegen(cx);
+		case CallStmtNode:
+			return methCall -> Codegen(cx);
+		case BlockStmtNode:
+			return block -> Codegen(cx);
+		case VoidReturnStmtNode:
+			cx.defaultRet = false;
+			return cx.Builder.CreateRetVoid();
+		case ReturnStmtNode: {
+			llvm::Value *val = return_value -> Codegen(cx);
+			cx.defaultRet = false;
+			return cx.Builder.CreateRet(val);
+		}
+		case WhileStmtNode: {
 		// Initialize
-			llvm::Function *TheFunction = Builder.GetInsertBlock() -> getParent();
-			llvm::BasicBlock *whilestartBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "whilestart", TheFunction);
-			llvm::BasicBlock *whiledoBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "whiledo", TheFunction);
-			llvm::BasicBlock *endBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "end", TheFunction);
+			llvm::Function *TheFunction = cx.Builder.GetInsertBlock() -> getParent();
+			llvm::BasicBlock *whilestartBB = llvm::BasicBlock::Create(cx.getContext(), "whilestart", TheFunction);
+			llvm::BasicBlock *whiledoBB = llvm::BasicBlock::Create(cx.getContext(), "whiledo", TheFunction);
+			llvm::BasicBlock *endBB = llvm::BasicBlock::Create(cx.getContext(), "end", TheFunction);
 
-			Builder.CreateBr(whilestartBB);
+			bool guarded = enterRange(cx);
+			cx.Builder.CreateBr(whilestartBB);
 			
 		// whilestart Basic Block
-			Builder.SetInsertPoint(whilestartBB);
-			llvm::Value *condV = condition->Codegen();
-			Builder.CreateCondBr(condV, whiledoBB, endBB);
+			cx.Builder.SetInsertPoint(whilestartBB);
+			condition->branch(cx, whiledoBB, endBB);
+			cx.ssa.seal(whiledoBB);
+			cx.ssa.seal(endBB);
 
 		// whiledo Basic Block
-			Builder.SetInsertPoint(whiledoBB);
-			while_block->Codegen();
-			Builder.CreateBr(whilestartBB);
+			cx.Builder.SetInsertPoint(whiledoBB);
+			while_block->Codegen(cx);
+			if(guarded)
+				cx.bounds.leave();
+			cx.Builder.CreateBr(whilestartBB);
+			// the back edge was the last way into the loop header
+			cx.ssa.seal(whilestartBB);
 
 		// end Basic Block
-			Builder.SetInsertPoint(endBB);
+			cx.Builder.SetInsertPoint(endBB);
+			return NULL;
 		}
-		else if(pre_assign_list != NULL && condition != NULL && loop_assign_list != NULL && for_block != NULL){
+		case ForStmtNode: {
 		// Initialize
-			llvm::Function *TheFunction = Builder.GetInsertBlock() -> getParent();
-			llvm::BasicBlock *forstartBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "forstart", TheFunction);
-			llvm::BasicBlock *fordoBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "fordo", TheFunction);
-			llvm::BasicBlock *endBB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "end", TheFunction);
+			llvm::Function *TheFunction = cx.Builder.GetInsertBlock() -> getParent();
+			llvm::BasicBlock *forstartBB = llvm::BasicBlock::Create(cx.getContext(), "forstart", TheFunction);
+			llvm::BasicBlock *fordoBB = llvm::BasicBlock::Create(cx.getContext(), "fordo", TheFunction);
+			llvm::BasicBlock *endBB = llvm::BasicBlock::Create(cx.getContext(), "end", TheFunction);
 
-			pre_assign_list->Codegen();
+			pre_assign_list->Codegen(cx);
+			bool guarded = enterRange(cx);
 			
-			Builder.CreateBr(forstartBB);
+			cx.Builder.CreateBr(forstartBB);
 
 		// forstart Basic Block
-			Builder.SetInsertPoint(forstartBB);
-			llvm::Value *condV = condition->Codegen();
-			Builder.CreateCondBr(condV, fordoBB, endBB);
+			cx.Builder.SetInsertPoint(forstartBB);
+			condition->branch(cx, fordoBB, endBB);
+			cx.ssa.seal(fordoBB);
+			cx.ssa.seal(endBB);
 			
 		// fordo Basic Block
-			Builder.SetInsertPoint(fordoBB);
+			cx.Builder.SetInsertPoint(fordoBB);
 			// block codegen
-			for_block->Codegen();
+			for_block->Codegen(cx);
+			if(guarded)
+				cx.bounds.leave();
 			// iterate
-			loop_assign_list->Codegen();
-			Builder.CreateBr(forstartBB);
+			loop_assign_list->Codegen(cx);
+			cx.Builder.CreateBr(forstartBB);
+			cx.ssa.seal(forstartBB);
 
 		// end Basic Block
-			Builder.SetInsertPoint(endBB);
-
+			cx.Builder.SetInsertPoint(endBB);
+			return NULL;
 		}
-		else if(condition != NULL && if_block != NULL && else_block != NULL){
-			llvm::Function *TheFunction = Builder.GetInsertBlock() -> getParent();
-			llvm::BasicBlock *ifStart = llvm::BasicBlock::Create(llvm::getGlobalContext(), "ifstart", TheFunction);
-			Builder.CreateBr(ifStart);
-			Builder.SetInsertPoint(ifStart);
-			llvm::Value *condV = condition -> Codegen();
-			TheFunction = Builder.GetInsertBlock() -> getParent();
-
-			llvm::BasicBlock *iftrue = llvm::BasicBlock::Create(llvm::getGlobalContext(), "iftrue", TheFunction);
-			llvm::BasicBlock *iffalse = llvm::BasicBlock::Create(llvm::getGlobalContext(), "iffalse");
-			llvm::BasicBlock *end = llvm::BasicBlock::Create(llvm::getGlobalContext(), "end");
-
-			Builder.CreateCondBr(condV, iftrue, iffalse);
-
-			//iftrue block Code Generation
-			Builder.SetInsertPoint(iftrue);
-			llvm::Value *vIfTrue = if_block -> Codegen();
-			Builder.CreateBr(end);
-			iftrue = Builder.GetInsertBlock();
-
-			//end block Code Genration (merge block)
-			TheFunction -> getBasicBlockList().push_back(end);
+		case IfStmtNode:
+			if(else_block != NULL){
+				llvm::Function *TheFunction = cx.Builder.GetInsertBlock() -> getParent();
+
+				llvm::BasicBlock *iftrue = llvm::BasicBlock::Create(cx.getContext(), "iftrue", TheFunction);
+				llvm::BasicBlock *iffalse = llvm::BasicBlock::Create(cx.getContext(), "iffalse");
+				llvm::BasicBlock *end = llvm::BasicBlock::Create(cx.getContext(), "end");
+
+				condition -> branch(cx, iftrue, iffalse);
+				cx.ssa.seal(iftrue);
+				cx.ssa.seal(iffalse);
+
+				//iftrue block Code Generation
+				cx.Builder.SetInsertPoint(iftrue);
+				llvm::Value *vIfTrue = if_block -> Codegen(cx);
+				cx.Builder.CreateBr(end);
+				iftrue = cx.Builder.GetInsertBlock();
+
+				//end block Code Genration (merge block)
+				TheFunction -> getBasicBlockList().push_back(end);
 			
-			//iffalse block Code Generation
-			TheFunction -> getBasicBlockList().push_back(iffalse);
-			Builder.SetInsertPoint(iffalse);
-			llvm::Value *vIfFalse = else_block -> Codegen();
-			Builder.CreateBr(end);
-			iffalse = Builder.GetInsertBlock();
+				//iffalse block Code Generation
+				TheFunction -> getBasicBlockList().push_back(iffalse);
+				cx.Builder.SetInsertPoint(iffalse);
+				llvm::Value *vIfFalse = else_block -> Codegen(cx);
+				cx.Builder.CreateBr(end);
+				iffalse = cx.Builder.GetInsertBlock();
+				cx.ssa.seal(end);
 			
-			Builder.SetInsertPoint(end);
-			defaultRet = true;
-		}
-		else if(condition != NULL && if_block != NULL && else_block == NULL){
-			llvm::Function *TheFunction = Builder.GetInsertBlock() -> getParent();
-			llvm::BasicBlock *ifStart = llvm::BasicBlock::Create(llvm::getGlobalContext(), "ifstart", TheFunction);
-			Builder.CreateBr(ifStart);
-			Builder.SetInsertPoint(ifStart);
-			llvm::Value *condV = condition -> Codegen();
-			TheFunction = Builder.GetInsertBlock() -> getParent();
-
-			llvm::BasicBlock *iftrue = llvm::BasicBlock::Create(llvm::getGlobalContext(), "iftrue", TheFunction);
-			llvm::BasicBlock *end = llvm::BasicBlock::Create(llvm::getGlobalContext(), "end");
-
-			Builder.CreateCondBr(condV, iftrue, end);
-
-			//iftrue block Code Generation
-			Builder.SetInsertPoint(iftrue);
-			llvm::Value *vIfTrue = if_block -> Codegen();
-			Builder.CreateBr(end);
-			iftrue = Builder.GetInsertBlock();
-
-			TheFunction -> getBasicBlockList().push_back(end);
-			Builder.SetInsertPoint(end);
-			defaultRet = true;
-		}
-		else{
+				cx.Builder.SetInsertPoint(end);
+				cx.defaultRet = true;
+				return NULL;
+			}else{
+				llvm::Function *TheFunction = cx.Builder.GetInsertBlock() -> getParent();
+
+				llvm::BasicBlock *iftrue = llvm::BasicBlock::Create(cx.getContext(), "iftrue", TheFunction);
+				llvm::BasicBlock *end = llvm::BasicBlock::Create(cx.getContext(), "end");
+
+				condition -> branch(cx, iftrue, end);
+				cx.ssa.seal(iftrue);
+
+				//iftrue block Code Generation
+				cx.Builder.SetInsertPoint(iftrue);
+				llvm::Value *vIfTrue = if_block -> Codegen(cx);
+				cx.Builder.CreateBr(end);
+				iftrue = cx.Builder.GetInsertBlock();
+
+				TheFunction -> getBasicBlockList().push_back(end);
+				cx.ssa.seal(end);
+				cx.Builder.SetInsertPoint(end);
+				cx.defaultRet = true;
+				return NULL;
+			}
+		default:
 			throw runtime_error("statement not currently supported");
 		}
 	}
-};
 
-class Constant : public decafAST {
-	string type;
-	int intval;
-	bool boolval;
-	char charval;
-public:
-	Constant(int val) : intval(val) { type = string("int");}
-	Constant(bool val) : boolval(val) { type = string("bool");}
-	Constant(char val) : charval(val) { type = string("char");}
-	~Constant(){}
-	string getType(){return type;}
-	int getInt(){return intval;}
-	bool getBool(){return boolval;}
-	char getChar(){return charval;}
+private:
+	// in front of a loop with a proven range, work out whether the range
+	// fits the arrays the body indexes, so the body can skip those checks;
+	// returns whether the caller has to leave the range after the body
+	bool enterRange(codegen_context &cx){
+		if(range.var == NULL || cx.bounds.mode != BoundsElide)
+			return false;
+		llvm::Value *start;
+		if(range.start != NULL)
+			start = range.start->Codegen(cx);
+		else if(cx.ssa.enabled)
+			start = cx.ssa.use(range.var, cx.Builder.GetInsertBlock());
+		else
+			start = cx.Builder.CreateLoad(declValue(range.var, cx), "start");
+		llvm::Value *bound = range.bound->Codegen(cx);
+		llvm::Value *size = cx.Builder.getInt32(range.size);
+		llvm::Value *low, *high;
+		if(!range.down){
+			low = cx.Builder.CreateICmpSGE(start, cx.Builder.getInt32(0), "rangelow");
+			high = range.inclusive ? cx.Builder.CreateICmpSLT(bound, size, "rangehigh") : cx.Builder.CreateICmpSLE(bound, size, "rangehigh");
+		}else{
+			low = cx.Builder.CreateICmpSGE(bound, cx.Builder.getInt32(range.inclusive ? 0 : -1), "rangelow");
+			high = cx.Builder.CreateICmpSLT(start, size, "rangehigh");
+		}
+		cx.bounds.enter(range.var, range.size, cx.Builder.CreateAnd(low, high, "inrange"));
+		return true;
+	}
 };
 
+// shardGlobal - a global of the main module as seen from a shard being
+// generated on another thread: declared in the shard on first use
+static llvm::GlobalValue *shardGlobal(atom name, llvm::Type *ty, codegen_context &cx) {
+	llvm::GlobalValue *g = cx.TheModule->getNamedValue(atoms.spelling(name));
+	if (g != NULL)
+		return g;
+	if (llvm::FunctionType *ft = llvm::dyn_cast<llvm::FunctionType>(ty))
+		return llvm::Function::Create(ft, llvm::Function::ExternalLinkage, atoms.spelling(name), cx.TheModule);
+	return new llvm::GlobalVariable(*cx.TheModule, ty, false, llvm::GlobalValue::ExternalLinkage, NULL, atoms.spelling(name));
+}
+
+// declValue - what a resolved name stands for in the IR being generated:
+// a stack slot for locals and parameters, the global for fields, the
+// function for externs and methods. A shard being generated on another
+// thread has not generated the globals itself and declares its own copies.
+llvm::Value *declValue(decafAST *d, codegen_context &cx) {
+	llvm::Value *v = cx.decls.lookup(d);
+	if (v != NULL)
+		return v;
+	switch (d->getKind()) {
+	case FieldDeclNode: {
+		FieldDeclAST *f = llvm::cast<FieldDeclAST>(d);
+		return shardGlobal(f->getName(), f->valueType(cx), cx);
+	}
+	case ExternNode: {
+		ExternAST *e = llvm::cast<ExternAST>(d);
+		return shardGlobal(e->getName(), e->functionType(cx), cx);
+	}
+	case MethodDeclNode: {
+		MethodDecl *m = llvm::cast<MethodDecl>(d);
+		return shardGlobal(m->getName(), m->functionType(cx), cx);
+	}
+	default:
+		throw runtime_error("name bound to something that is not a declaration");
+	}
+}
+
+decafAST *read_node(ast_reader &r, arena &a, NodeKind k);
+
+// read a child written by writeNode, which must be missing or a T
+template <class T>
+T *read_child(ast_reader &r, arena &a) {
+	NodeKind k = r.kind();
+	if (k == NullNode) {
+		return NULL;
+	}
+	T *n = llvm::dyn_cast<T>(read_node(r, a, k));
+	if (n == NULL) {
+		throw runtime_error("unexpected node kind in binary AST");
+	}
+	return n;
+}
+
+static unsigned long read_enum(ast_reader &r, unsigned long last) {
+	unsigned long n = r.number();
+	if (n > last) {
+		throw runtime_error("bad enum value in binary AST");
+	}
+	return n;
+}
+
+// read_node - rebuild a node of kind k, allocated from a, out of the
+// fields its write() emitted, using the same constructors as the parser
+decafAST *read_node(ast_reader &r, arena &a, NodeKind k) {
+	switch (k) {
+	case StmtListNode: {
+		decafStmtList *list = new (a) decafStmtList();
+		unsigned long n = r.number();
+		for (unsigned long i = 0; i < n; i++) {
+			list->push_back(read_child<decafAST>(r, a));
+		}
+		return list;
+	}
+	case PackageNode: {
+		atom name = r.name();
+		decafStmtList *fields = read_child<decafStmtList>(r, a);
+		decafStmtList *methods = read_child<decafStmtList>(r, a);
+		return new (a) PackageAST(name, fields, methods);
+	}
+	case ProgramNode: {
+		decafStmtList *externs = read_child<decafStmtList>(r, a);
+		PackageAST *pkg = read_child<PackageAST>(r, a);
+		return new (a) ProgramAST(externs, pkg);
+	}
+	case DecafTypeNode:
+		return new (a) DecafTypeAST((DecafType) read_enum(r, StringType));
+	case MethodTypeNode:
+		return new (a) MethodTypeAST((DecafType) read_enum(r, StringType));
+	case ExternTypeNode:
+		return new (a) ExternTypeAST((DecafType) read_enum(r, StringType));
+	case TypedSymbolNode: {
+		atom name = r.name();
+		return new (a) TypedSymbolAST(name, read_child<DecafTypeAST>(r, a));
+	}
+	case ExternNode: {
+		atom name = r.name();
+		MethodTypeAST *rt = read_child<MethodTypeAST>(r, a);
+		decafStmtList *types = read_child<decafStmtList>(r, a);
+		return new (a) ExternAST(name, rt, types);
+	}
+	case BinaryOperatorNode:
+		return new (a) BinaryOperator((BinaryOp) read_enum(r, Or));
+	case UnaryOperatorNode:
+		return new (a) UnaryOperator((UnaryOp) read_enum(r, Not));
+	case MethodCallNode: {
+		atom name = r.name();
+		return new (a) MethodCallAST(name, read_child<decafStmtList>(r, a));
+	}
+	case RvalueExprNode:
+		return new (a) Expr(read_child<decafStmtList>(r, a));
+	case CallExprNode:
+		return new (a) Expr(read_child<MethodCallAST>(r, a));
+	case IntExprNode:
+		return new (a) Expr((int) r.signed_number());
+	case BoolExprNode:
+		return new (a) Expr(r.number() != 0);
+	case BinaryExprNode: {
+		BinaryOperator *op = read_child<BinaryOperator>(r, a);
+		Expr *lv = read_child<Expr>(r, a);
+		Expr *rv = read_child<Expr>(r, a);
+		return new (a) Expr(op, lv, rv);
+	}
+	case UnaryExprNode: {
+		UnaryOperator *op = read_child<UnaryOperator>(r, a);
+		return new (a) Expr(op, read_child<Expr>(r, a));
+	}
+	case FieldSizeNode: {
+		DecafTypeAST *t = read_child<DecafTypeAST>(r, a);
+		int size = r.signed_number();
+		return t == NULL ? new (a) FieldSize() : new (a) FieldSize(size, t);
+	}
+	case FieldDeclNode: {
+		atom name = r.name();
+		DecafTypeAST *t = read_child<DecafTypeAST>(r, a);
+		FieldDeclAST *fd;
+		if (read_enum(r, 1) == 0) {
+			fd = new (a) FieldDeclAST(name, t, read_child<FieldSize>(r, a));
+		} else {
+			fd = new (a) FieldDeclAST(name, t, read_child<Expr>(r, a));
+		}
+		fd->setRange(r.range());
+		return fd;
+	}
+	case MethodArgNode:
+		if (read_enum(r, 1) == 0) {
+			return new (a) MethodArg(read_child<Expr>(r, a));
+		}
+		return new (a) MethodArg(r.name());
+	case MethodBlockNode: {
+		decafStmtList *vars = read_child<decafStmtList>(r, a);
+		decafStmtList *stmts = read_child<decafStmtList>(r, a);
+		return new (a) MethodBlock(vars, stmts);
+	}
+	case MethodDeclNode: {
+		atom name = r.name();
+		MethodTypeAST *rt = read_child<MethodTypeAST>(r, a);
+		decafStmtList *params = read_child<decafStmtList>(r, a);
+		MethodBlock *b = read_child<MethodBlock>(r, a);
+		MethodDecl *m = new (a) MethodDecl(name, rt, params, b);
+		m->setBodyRange(r.range());
+		return m;
+	}
+	case RvalueNode: {
+		atom name = r.name();
+		return new (a) Rvalue(name, read_child<Expr>(r, a));
+	}
+	case AssignNode: {
+		atom name = r.name();
+		Expr *index = read_child<Expr>(r, a);
+		Expr *value = read_child<Expr>(r, a);
+		return new (a) Assign(name, index, value);
+	}
+	case BlockNode: {
+		decafStmtList *vars = read_child<decafStmtList>(r, a);
+		decafStmtList *stmts = read_child<decafStmtList>(r, a);
+		return new (a) Block(vars, stmts);
+	}
+	case AssignStmtNode:
+		return new (a) StatementAST(read_child<Assign>(r, a));
+	case CallStmtNode:
+		return new (a) StatementAST(read_child<MethodCallAST>(r, a));
+	case IfStmtNode: {
+		Expr *c = read_child<Expr>(r, a);
+		Block *i = read_child<Block>(r, a);
+		Block *e = read_child<Block>(r, a);
+		return new (a) StatementAST(c, i, e);
+	}
+	case WhileStmtNode: {
+		Expr *c = read_child<Expr>(r, a);
+		return new (a) StatementAST(c, read_child<Block>(r, a));
+	}
+	case ForStmtNode: {
+		decafStmtList *pre = read_child<decafStmtList>(r, a);
+		Expr *c = read_child<Expr>(r, a);
+		decafStmtList *loop = read_child<decafStmtList>(r, a);
+		Block *b = read_child<Block>(r, a);
+		return new (a) StatementAST(pre, c, loop, b);
+	}
+	case ReturnStmtNode:
+		return new (a) StatementAST(read_child<Expr>(r, a));
+	case BlockStmtNode:
+		return new (a) StatementAST(read_child<Block>(r, a));
+	case VoidReturnStmtNode:
+		return new (a) StatementAST(k, read_child<decafStmtList>(r, a));
+	case BreakStmtNode:
+	case ContinueStmtNode:
+		return new (a) StatementAST(k);
+	default:
+		throw runtime_error("unexpected node kind in binary AST");
+	}
+}
+
+// write prog as a binary AST
+void write_ast(ostream &os, ProgramAST *prog) {
+	ast_writer w(os);
+	writeNode(w, prog);
+}
+
+// load a binary AST written by write_ast into a; the nodes live as long as a
+ProgramAST *read_ast(const char *data, size_t size, arena &a) {
+	ast_reader r(data, size);
+	ProgramAST *prog = read_child<ProgramAST>(r, a);
+	if (prog == NULL || !r.done()) {
+		throw runtime_error("malformed binary AST");
+	}
+	return prog;
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Code Generation ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // prog = Program(extern* extern_list, package body)
 // extern = ExternFunction(identifier name, method_type return_type, extern_type* typelist)
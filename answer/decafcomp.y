@@ -1,21 +1,32 @@
 %{
 #include <iostream>
 #include <ostream>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <cstdlib>
 #include <list>
 #include <vector>
+#include <chrono>
+#include <sys/resource.h>
 #include "decafast-defs.h"
 
-int yylex(void);
-int yyerror(char *); 
-
 // print AST?
 bool printAST = false;
 
 #include "decafast.cc"
-
-extern int lineno;
+#include "visitor.cc"
+#include "resolve.cc"
+#include "thread_pool.cc"
+#include "semantic.cc"
+#include "fold.cc"
+#include "ranges.cc"
+#include "parallel_codegen.cc"
+#include "optimize.cc"
+#include "jit.cc"
+#include "object_file.cc"
+#include "compile.cc"
+#include "watch.cc"
 
 using namespace std;
 
@@ -36,17 +47,17 @@ using namespace std;
 static llvm::Function *TheFunction = 0;
 
 // we have to create a main function f
-llvm::Function *gen_main_def() {
+llvm::Function *gen_main_def(codegen_context &cx) {
   // create the top-level definition for main
-  llvm::FunctionType *FT = llvm::FunctionType::get(llvm::IntegerType::get(llvm::getGlobalContext(), 32), false);
-  llvm::Function *TheFunction = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, "main", TheModule);
+  llvm::FunctionType *FT = llvm::FunctionType::get(llvm::IntegerType::get(cx.getContext(), 32), false);
+  llvm::Function *TheFunction = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, "main", cx.TheModule);
   if (TheFunction == 0) {
     throw runtime_error("empty function block"); 
   }
   // Create a new basic block which contains a sequence of LLVM instructions
-  llvm::BasicBlock *BB = llvm::BasicBlock::Create(llvm::getGlobalContext(), "entry", TheFunction);
+  llvm::BasicBlock *BB = llvm::BasicBlock::Create(cx.getContext(), "entry", TheFunction);
   // All subsequent calls to IRBuilder will place instructions in this location
-  Builder.SetInsertPoint(BB);
+  cx.Builder.SetInsertPoint(BB);
   return TheFunction;
 }
 
@@ -57,10 +68,16 @@ llvm::Function *gen_main_def() {
 
 %}
 
+%define api.pure full
+%locations
+%parse-param {parse_state *ps}
+%lex-param {parse_state *ps}
+
 %union{
     class decafAST *ast;
     class StringList *slist;
     std::string *sval;
+    atom aval;
     int ival;
     char cval;
 }
@@ -111,17 +128,17 @@ llvm::Function *gen_main_def() {
 %token T_LT
 %token T_NOT
 %token T_COMMENT
-%token <sval> T_STRINGCONSTANT 
-%token <sval> T_CHARCONSTANT
+%token <aval> T_STRINGCONSTANT 
+%token <aval> T_CHARCONSTANT
 %token <ival> T_INTCONSTANT
 
-%token <sval> T_ID
+%token <aval> T_ID
 
-%type <ast> type methodType arrayType externType externs externTypes externTypeList_item externTypeList extern_list decafpackage externDefn typed_symbol var_dec_list booleanOperator unaryOperator unaryNot unaryMinus arithmeticOp methodCall methodArg methodArgList methodArgListItem expr binaryOperator fieldDeclarations fieldDeclarationList fieldDeclarationListItem fieldDeclaration assign assignListItem assignList constant boolConstant block statement varDecls varDecl statements typedSymbol typedSymbols typedSymbolList typedSymbolListItem methodDecls methodDecl methodArgs methodBlock 
+%type <ast> type methodType arrayType externType externs externTypes externTypeList extern_list decafpackage externDefn typed_symbol var_dec_list booleanOperator unaryOperator unaryNot unaryMinus arithmeticOp methodCall methodArg methodArgList expr binaryOperator fieldDeclarations fieldDeclarationList fieldDeclarationListItem fieldDeclaration assign assignList constant boolConstant block statement varDecls varDecl statements typedSymbol typedSymbols typedSymbolList methodDecls methodDecl methodArgs methodBlock 
 
 
-%type <slist> idList idList_item 
-%type <sval> id stringConstant
+%type <slist> idList 
+%type <aval> id stringConstant
 
 
 %left T_OR
@@ -138,132 +155,111 @@ start: program
 
 program: externs decafpackage 
     { 
-        ProgramAST *prog = new ProgramAST((decafStmtList *)$1, (PackageAST *)$2); 
-        if (printAST) {
-            cout << getString(prog) << endl;
-        }
-        try {
-            prog -> Codegen();
-        } 
-        catch (std::runtime_error &e) {
-            cout << "semantic error: " << e.what() << endl;
-            //cout << prog->str() << endl; 
-            exit(EXIT_FAILURE);
-        }
-        delete prog;
+        ProgramAST *prog = new (ps->nodes) ProgramAST(llvm::cast<decafStmtList>($1), llvm::cast<PackageAST>($2)); 
+        ps->prog = prog;
     }
     ;
-externs : extern_list {decafStmtList *slist = (decafStmtList*) $1; $$ = slist;}
-    |  {decafStmtList *slist = new decafStmtList(); $$ = slist; }
+/* all list rules are left recursive so the parser stack stays flat however
+   long the list grows; each element is appended to the list built so far */
+
+externs : extern_list {decafStmtList *slist = llvm::cast<decafStmtList>($1); $$ = slist;}
     ;
 
-extern_list: externDefn extern_list { decafStmtList *slist = (decafStmtList*) $2; slist->push_front($1); $$ = slist;}
-    |  {decafStmtList *slist = new decafStmtList(); $$ = slist; }
+extern_list: extern_list externDefn { decafStmtList *slist = llvm::cast<decafStmtList>($1); slist->push_back($2); $$ = slist;}
+    |  {decafStmtList *slist = new (ps->nodes) decafStmtList(); $$ = slist; }
     ;
 
 
 externDefn: T_EXTERN T_FUNC T_ID T_LPAREN externTypes T_RPAREN methodType T_SEMICOLON
     { 
-        string tid_str = $3->c_str();
-        MethodTypeAST *mt = (MethodTypeAST*) $7;
-        decafStmtList *dsl = (decafStmtList*) $5;
+        atom tid = $3;
+        MethodTypeAST *mt = llvm::cast<MethodTypeAST>($7);
+        decafStmtList *dsl = llvm::cast<decafStmtList>($5);
 
-        ExternAST* extDfn = new ExternAST(tid_str, mt, dsl); 
+        ExternAST* extDfn = new (ps->nodes) ExternAST(tid, mt, dsl); 
         $$ = extDfn;
     }
     ;
 externTypes : externTypeList {$$ = $1;}
-	| {decafStmtList *dsl = new decafStmtList(); $$ = dsl;}
+	| {decafStmtList *dsl = new (ps->nodes) decafStmtList(); $$ = dsl;}
 
-externTypeList: externType externTypeList_item { 
+externTypeList: externType { 
 
-        ExternTypeAST *et  = (ExternTypeAST*) $1;
-        decafStmtList *dsl = (decafStmtList*) $2;
-        dsl->push_front(et);
+        ExternTypeAST *et  = llvm::cast<ExternTypeAST>($1);
+        decafStmtList *dsl = new (ps->nodes) decafStmtList();
+        dsl->push_back(et);
         $$ = dsl;
     }
-    ;
-
-externTypeList_item: T_COMMA externType externTypeList_item { 
+    | externTypeList T_COMMA externType { 
 
-        ExternTypeAST *et = (ExternTypeAST*) $2;
-        decafStmtList *dsl  = (decafStmtList*) $3;
-        dsl->push_front(et);
+        ExternTypeAST *et = llvm::cast<ExternTypeAST>($3);
+        decafStmtList *dsl  = llvm::cast<decafStmtList>($1);
+        dsl->push_back(et);
         $$ = dsl;
      }
-     | { decafStmtList *dsl = new decafStmtList(); $$ = dsl; }
     ;
 
-decafpackage: T_PACKAGE T_ID decafpackage_begin fieldDeclarations methodDecls decafpackage_end
-    {   $$ = new PackageAST(*$2, (decafStmtList*)$4, (decafStmtList*)$5);
+decafpackage: T_PACKAGE T_ID T_LCB fieldDeclarations methodDecls T_RCB
+    {   $$ = new (ps->nodes) PackageAST($2, llvm::cast<decafStmtList>($4), llvm::cast<decafStmtList>($5));
         //delete $2; 
     }
     ;
-decafpackage_begin: T_LCB { syms.new_symtbl(); }
-    ;
-decafpackage_end: T_RCB { syms.remove_symtbl(); }
-    ;
 
 
 /* FIELD DECLARATION */
 
-fieldDeclarations: fieldDeclarationList { decafStmtList *dsl = (decafStmtList*) $1; $$ = dsl; }
-    | {decafStmtList *dsl = new decafStmtList(); $$ = dsl; }
+fieldDeclarations: fieldDeclarationList { decafStmtList *dsl = llvm::cast<decafStmtList>($1); $$ = dsl; }
     ;
 
-fieldDeclarationList : fieldDeclaration fieldDeclarationList {
+fieldDeclarationList : fieldDeclarationList fieldDeclaration {
        
-        decafStmtList *dsl = (decafStmtList*) $2;
-        dsl->push_front($1);
+        decafStmtList *dsl = llvm::cast<decafStmtList>($1);
+        dsl->push_back($2);
         $$ = dsl;
     }
-    | {decafStmtList *dsl = new decafStmtList(); $$ = dsl;}
+    | {decafStmtList *dsl = new (ps->nodes) decafStmtList(); $$ = dsl;}
     ;
 
 
 fieldDeclaration: T_VAR idList type T_SEMICOLON{
        
-        decafStmtList *dsl = new decafStmtList();
-        string curr_id;
-        DecafTypeAST *type = (DecafTypeAST*)$3;
+        decafStmtList *dsl = new (ps->nodes) decafStmtList();
+        atom curr_id;
+        DecafTypeAST *type = llvm::cast<DecafTypeAST>($3);
         StringList *sList = (StringList*)$2;
-        list<string> idList = sList->getList();
-        //idList.push_front(*$2);
+        llvm::ArrayRef<atom> idList = sList->getList();
 
-        for(list<string>::const_iterator iter = idList.begin(); iter != idList.end(); ++iter){
+        for(llvm::ArrayRef<atom>::iterator iter = idList.begin(); iter != idList.end(); ++iter){
             curr_id = *iter;
-            dsl->push_back(new FieldDeclAST(curr_id, type, new FieldSize()));
+            FieldDeclAST *fd = new (ps->nodes) FieldDeclAST(curr_id, type, new (ps->nodes) FieldSize());
+            fd->setRange(@$);
+            dsl->push_back(fd);
             //enter_symtbl(curr_id, type -> str(), lineno);
         }
         $$ = dsl;
     }
     | T_VAR T_ID type T_SEMICOLON{
         
-        decafStmtList *dsl = new decafStmtList();
-        string curr_id;
-        DecafTypeAST *type = (DecafTypeAST*)$3;
-        StringList *sList = new StringList();
-        list<string> idList = sList->getList();
-        idList.push_front(*$2);
-
-        for(list<string>::const_iterator iter = idList.begin(); iter != idList.end(); ++iter){
-            curr_id = *iter;
-            dsl->push_back(new FieldDeclAST(curr_id, type, new FieldSize()));
-            //enter_symtbl(curr_id, type -> str(), lineno);
-        }
+        decafStmtList *dsl = new (ps->nodes) decafStmtList();
+        DecafTypeAST *type = llvm::cast<DecafTypeAST>($3);
+        FieldDeclAST *fd = new (ps->nodes) FieldDeclAST($2, type, new (ps->nodes) FieldSize());
+        fd->setRange(@$);
+        dsl->push_back(fd);
         $$ = dsl;
     }
 	| T_VAR idList arrayType T_SEMICOLON{
         
-        decafStmtList *dsl = new decafStmtList();
-        string curr_id;
-        FieldSize *fs = (FieldSize*) $3;
+        decafStmtList *dsl = new (ps->nodes) decafStmtList();
+        atom curr_id;
+        FieldSize *fs = llvm::cast<FieldSize>($3);
         DecafTypeAST *type = fs->getType();
         
-        list<string> idList = $2->getList();
-        for(list<string>::const_iterator iter = idList.begin(); iter != idList.end(); ++iter){
+        llvm::ArrayRef<atom> idList = $2->getList();
+        for(llvm::ArrayRef<atom>::iterator iter = idList.begin(); iter != idList.end(); ++iter){
             curr_id = *iter;
-            dsl->push_back(new FieldDeclAST(curr_id, type, fs));
+            FieldDeclAST *fd = new (ps->nodes) FieldDeclAST(curr_id, type, fs);
+            fd->setRange(@$);
+            dsl->push_back(fd);
             //enter_symtbl(curr_id, type -> str(), lineno);
         }
         $$ = dsl;
@@ -271,230 +267,209 @@ fieldDeclaration: T_VAR idList type T_SEMICOLON{
     }
     | T_VAR T_ID type T_ASSIGN constant T_SEMICOLON { 
         
-        string n = *$2;
-        DecafTypeAST *t = (DecafTypeAST*) $3;
-        Expr *v = (Expr*) $5;
-        FieldDeclAST *fd = new FieldDeclAST(n, t, v);
+        atom n = $2;
+        DecafTypeAST *t = llvm::cast<DecafTypeAST>($3);
+        Expr *v = llvm::cast<Expr>($5);
+        FieldDeclAST *fd = new (ps->nodes) FieldDeclAST(n, t, v);
+        fd->setRange(@$);
         //enter_symtbl(n, t -> str(), lineno);
         $$ = fd;
     }
     ;
 
-idList: T_ID idList_item { StringList *sl = (StringList*) $2; sl->push_front(*$1); $$ = sl;};
-
-idList_item: T_COMMA T_ID idList_item { StringList *sl = (StringList*) $3; sl->push_front(*$2); $$ = sl; }
-	| { StringList *sl = new StringList(); $$ = sl; }
+idList: T_ID { StringList *sl = new (ps->nodes) StringList(); sl->push_back($1); $$ = sl; }
+	| idList T_COMMA T_ID { StringList *sl = (StringList*) $1; sl->push_back($3); $$ = sl; }
 	;
 
 id : T_ID { $$ = $1; }
 	;
 
-assignList: assign assignListItem { decafStmtList *dsl = (decafStmtList*) $2; dsl->push_front((Assign*)$1); $$ = dsl; }
-	;
-
-assignListItem : T_COMMA assign assignListItem { decafStmtList *dsl = (decafStmtList*) $3; dsl->push_front((Assign*)$2); $$ = dsl; }
-    | {decafStmtList *dsl = new decafStmtList(); $$ = dsl; }
+assignList: assign { decafStmtList *dsl = new (ps->nodes) decafStmtList(); dsl->push_back(llvm::cast<Assign>($1)); $$ = dsl; }
+	| assignList T_COMMA assign { decafStmtList *dsl = llvm::cast<decafStmtList>($1); dsl->push_back(llvm::cast<Assign>($3)); $$ = dsl; }
 	;
 
 
 
 assign: T_ID T_ASSIGN expr 
-        { Assign *a = new Assign(*$1, (Expr*)$3); 
+        { Assign *a = new (ps->nodes) Assign($1, llvm::cast<Expr>($3)); 
         //cout << " // using decl on line: " << syms.access_symtbl(*$1) -> lineno; 
         $$ = a; }
 	| T_ID T_LSB expr T_RSB T_ASSIGN expr 
-        { Assign *a = new Assign(*$1, (Expr*)$3, (Expr*)$6); 
+        { Assign *a = new (ps->nodes) Assign($1, llvm::cast<Expr>($3), llvm::cast<Expr>($6)); 
         //cout << " // using decl on line: " << syms.access_symtbl(*$1) -> lineno; 
         $$ = a; } 
 	;
 
 /* METHOD DECLARATIONS */
 
-methodDecls: methodDecl methodDecls { decafStmtList *dsl = (decafStmtList*)$2; dsl -> push_front($1); $$ = dsl; }
-	| { decafStmtList *dsl = new decafStmtList(); $$ = dsl; }
+methodDecls: methodDecls methodDecl { decafStmtList *dsl = llvm::cast<decafStmtList>($1); dsl -> push_back($2); $$ = dsl; }
+	| { decafStmtList *dsl = new (ps->nodes) decafStmtList(); $$ = dsl; }
 	;
 
 methodDecl: T_FUNC T_ID T_LPAREN typedSymbols T_RPAREN methodType methodBlock {
-	string name = *$2;
-	MethodTypeAST *mt = (MethodTypeAST*) $6; // $6;
-	decafStmtList *pList = (decafStmtList*) $4;
-	MethodBlock *mb = (MethodBlock*)$7;
-	MethodDecl *m = new MethodDecl(name, mt, pList, mb); $$ = m;
+	atom name = $2;
+	MethodTypeAST *mt = llvm::cast<MethodTypeAST>($6); // $6;
+	decafStmtList *pList = llvm::cast<decafStmtList>($4);
+	MethodBlock *mb = llvm::cast<MethodBlock>($7);
+	MethodDecl *m = new (ps->nodes) MethodDecl(name, mt, pList, mb); $$ = m;
+	m->setBodyRange(@7);
 	}
 	;
 
-//methodBlock: T_LCB varDecls statements T_RCB { MethodBlock *mb = new MethodBlock((decafStmtList*)$2, (decafStmtList*)$3); $$ = mb; } 
-methodBlock: methodBlock_begin varDecls statements methodBlock_end { MethodBlock *mb = new MethodBlock((decafStmtList*)$2, (decafStmtList*)$3); $$ = mb; }
+//methodBlock: T_LCB varDecls statements T_RCB { MethodBlock *mb = new (ps->nodes) MethodBlock(llvm::cast<decafStmtList>($2), llvm::cast<decafStmtList>($3)); $$ = mb; } 
+methodBlock: T_LCB varDecls statements T_RCB { MethodBlock *mb = new (ps->nodes) MethodBlock(llvm::cast<decafStmtList>($2), llvm::cast<decafStmtList>($3)); $$ = mb; }
     ; 
 
-methodBlock_begin: T_LCB { syms.new_symtbl(); }
-    ;
-
-methodBlock_end: T_RCB { syms.remove_symtbl(); }
-    ;
-
-typedSymbols: typedSymbolList { decafStmtList *dsl = (decafStmtList*)$1;}
-	| { decafStmtList *dsl = new decafStmtList(); $$ = dsl;}
+typedSymbols: typedSymbolList { decafStmtList *dsl = llvm::cast<decafStmtList>($1);}
+	| { decafStmtList *dsl = new (ps->nodes) decafStmtList(); $$ = dsl;}
 	;
 
-typedSymbolList: typedSymbol typedSymbolListItem {
-		decafStmtList *dsl = (decafStmtList*)$2; dsl -> push_front((TypedSymbolAST*)$1); $$ = dsl;	
+typedSymbolList: typedSymbol {
+		decafStmtList *dsl = new (ps->nodes) decafStmtList(); dsl -> push_back(llvm::cast<TypedSymbolAST>($1)); $$ = dsl;	
 	}
-	;
-
-typedSymbolListItem: T_COMMA typedSymbol typedSymbolListItem {
-		decafStmtList *dsl = (decafStmtList*)$3; dsl -> push_front($2); $$ = dsl;	
+	| typedSymbolList T_COMMA typedSymbol {
+		decafStmtList *dsl = llvm::cast<decafStmtList>($1); dsl -> push_back($3); $$ = dsl;	
 	} 
-	| { decafStmtList *dsl = new decafStmtList(); $$ = dsl; }
 	;
 
 typedSymbol : T_ID type {
-		TypedSymbolAST *t = new TypedSymbolAST(*$1, (DecafTypeAST*)$2); $$ = t;
-        DecafTypeAST *d = (DecafTypeAST*)$2;
-        //enter_symtbl(*$1, d -> str(), lineno);			
+		TypedSymbolAST *t = new (ps->nodes) TypedSymbolAST($1, llvm::cast<DecafTypeAST>($2)); $$ = t;
+        DecafTypeAST *d = llvm::cast<DecafTypeAST>($2);
+        //enter_symtbl($1, d -> str(), lineno);			
 	}	
 	;
 
 /*METHOD CALL*/ 
 methodCall : T_ID T_LPAREN methodArgs T_RPAREN 
-    { MethodCallAST *mc = new MethodCallAST(*$1, (decafStmtList*) $3); $$ = mc; }
+    { MethodCallAST *mc = new (ps->nodes) MethodCallAST($1, llvm::cast<decafStmtList>($3)); $$ = mc; }
 	;
 
-methodArgs: methodArgList { decafStmtList *dsl = (decafStmtList*)$1; $$ = dsl; }
-		| { decafStmtList *dsl = new decafStmtList(); $$ = dsl; }
+methodArgs: methodArgList { decafStmtList *dsl = llvm::cast<decafStmtList>($1); $$ = dsl; }
+		| { decafStmtList *dsl = new (ps->nodes) decafStmtList(); $$ = dsl; }
 		;
 
-methodArgList : methodArg methodArgListItem { 
-			decafStmtList *dsl = (decafStmtList*) $2; 
-			dsl->push_front((MethodArg*)$1); 
+methodArgList : methodArg { 
+			decafStmtList *dsl = new (ps->nodes) decafStmtList(); 
+			dsl->push_back(llvm::cast<MethodArg>($1)); 
 			$$ = dsl;
 		}
+		| methodArgList T_COMMA methodArg { decafStmtList *dsl = llvm::cast<decafStmtList>($1); dsl->push_back(llvm::cast<MethodArg>($3)); $$ = dsl; }
 		;
 
-methodArgListItem : T_COMMA methodArg methodArgListItem { decafStmtList *dsl = (decafStmtList*) $3; dsl->push_front((MethodArg*)$2); $$ = dsl; }
-	| { decafStmtList *dsl = new decafStmtList(); $$ = dsl;}
-	;
-
-methodArg : stringConstant { string s = *$1; MethodArg *ma = new MethodArg(s); $$ = ma; }
-    | expr { MethodArg *ma = new MethodArg((Expr*)$1); $$ = ma; }
+methodArg : stringConstant { MethodArg *ma = new (ps->nodes) MethodArg($1); $$ = ma; }
+    | expr { MethodArg *ma = new (ps->nodes) MethodArg(llvm::cast<Expr>($1)); $$ = ma; }
     ;
 stringConstant: T_STRINGCONSTANT { $$ = $1; }
 
 
 expr: T_ID { 
-        decafStmtList *dsl = new decafStmtList();
-        Rvalue *rval = new Rvalue(*$1);
-        dsl->push_front(rval);
-        Expr *e = new Expr(dsl);
+        decafStmtList *dsl = new (ps->nodes) decafStmtList();
+        Rvalue *rval = new (ps->nodes) Rvalue($1);
+        dsl->push_back(rval);
+        Expr *e = new (ps->nodes) Expr(dsl);
         //cout << " // using decl on line: " << syms.access_symtbl(*$1) -> lineno; 
         $$ = e; 
     }
     | T_ID T_LSB expr T_RSB { 
-        decafStmtList *dsl = new decafStmtList();
-        Rvalue *rval = new Rvalue(*$1, (Expr*)$3);
-        dsl->push_front(rval);
-        Expr *e = new Expr(dsl);
+        decafStmtList *dsl = new (ps->nodes) decafStmtList();
+        Rvalue *rval = new (ps->nodes) Rvalue($1, llvm::cast<Expr>($3));
+        dsl->push_back(rval);
+        Expr *e = new (ps->nodes) Expr(dsl);
         //cout << " // using decl on line: " << syms.access_symtbl(*$1) -> lineno;
         $$ = e; 
     }
     | methodCall 
-        { Expr *e = new Expr((MethodCallAST*)$1); $$ = e; }
+        { Expr *e = new (ps->nodes) Expr(llvm::cast<MethodCallAST>($1)); $$ = e; }
     | constant 
         { $$ = $1; }
     | expr T_PLUS expr
-        { BinaryOperator *ao = new BinaryOperator("+"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Plus); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_MINUS expr
-        { BinaryOperator *ao = new BinaryOperator("-"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Minus); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_MULT expr
-        { BinaryOperator *ao = new BinaryOperator("*"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Mult); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_DIV expr
-        { BinaryOperator *ao = new BinaryOperator("/"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Div); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_LEFTSHIFT expr
-        { BinaryOperator *ao = new BinaryOperator("<<"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Leftshift); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_RIGHTSHIFT expr
-        { BinaryOperator *ao = new BinaryOperator(">>"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Rightshift); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_MOD expr
-        { BinaryOperator *ao = new BinaryOperator("%"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Mod); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_LT expr
-        { BinaryOperator *ao = new BinaryOperator("<"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Lt); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_GT expr
-        { BinaryOperator *ao = new BinaryOperator(">"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Gt); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_LEQ expr
-        { BinaryOperator *ao = new BinaryOperator("<="); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Leq); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_GEQ expr
-        { BinaryOperator *ao = new BinaryOperator(">="); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Geq); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_EQ expr
-        { BinaryOperator *ao = new BinaryOperator("=="); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Eq); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_NEQ expr
-        { BinaryOperator *ao = new BinaryOperator("!="); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Neq); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_AND expr
-        { BinaryOperator *ao = new BinaryOperator("&&"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(And); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | expr T_OR expr
-        { BinaryOperator *ao = new BinaryOperator("||"); Expr *e = new Expr(ao, (Expr*)$1, (Expr*)$3); $$ = e; }
+        { BinaryOperator *ao = new (ps->nodes) BinaryOperator(Or); Expr *e = new (ps->nodes) Expr(ao, llvm::cast<Expr>($1), llvm::cast<Expr>($3)); $$ = e; }
     | T_MINUS expr %prec UMINUS 
-        { UnaryOperator *uo = new UnaryOperator("-"); $$ = uo; Expr *e = new Expr(uo, (Expr*)$2); $$ = e;}
+        { UnaryOperator *uo = new (ps->nodes) UnaryOperator(UnaryMinus); $$ = uo; Expr *e = new (ps->nodes) Expr(uo, llvm::cast<Expr>($2)); $$ = e;}
     | T_NOT expr
-        { UnaryOperator *uo = new UnaryOperator("!"); $$ = uo; Expr *e = new Expr(uo, (Expr*)$2); $$ = e;}
+        { UnaryOperator *uo = new (ps->nodes) UnaryOperator(Not); $$ = uo; Expr *e = new (ps->nodes) Expr(uo, llvm::cast<Expr>($2)); $$ = e;}
     | T_LPAREN expr T_RPAREN
         { $$ = $2; }
     ;
 
-block: begin_block varDecls statements end_block { Block *b = new Block((decafStmtList*)$2, (decafStmtList*)$3); $$ = b; }
+block: T_LCB varDecls statements T_RCB { Block *b = new (ps->nodes) Block(llvm::cast<decafStmtList>($2), llvm::cast<decafStmtList>($3)); $$ = b; }
 	;
 
-begin_block: T_LCB { syms.new_symtbl(); }
-    ;
-
-end_block: T_RCB { syms.remove_symtbl(); }
-    ;
-
-statements: statement statements {
-		decafStmtList *dsl = (decafStmtList*)$2;
-		dsl -> push_front($1);
+statements: statements statement {
+		decafStmtList *dsl = llvm::cast<decafStmtList>($1);
+		dsl -> push_back($2);
 		$$ = dsl;	
 	}
-	| { decafStmtList *dsl = new decafStmtList(); $$ = dsl; }
+	| { decafStmtList *dsl = new (ps->nodes) decafStmtList(); $$ = dsl; }
 	;
 
-statement: block { StatementAST *s = new StatementAST((Block*)$1); $$ = s; }
-	| methodCall T_SEMICOLON { StatementAST *s = new StatementAST((MethodCallAST*)$1); $$ = s; }
-	| assign T_SEMICOLON { StatementAST *s = new StatementAST((Assign*)$1); $$ = s; }
-	| T_IF T_LPAREN expr T_RPAREN block { StatementAST *s = new StatementAST((Expr*)$3, (Block*)$5, (Block*)NULL); $$ = s; }
-	| T_IF T_LPAREN expr T_RPAREN block T_ELSE block { StatementAST *s = new StatementAST((Expr*)$3, (Block*)$5, (Block*)$7); $$ = s; }	
-	| T_WHILE T_LPAREN expr T_RPAREN block { StatementAST *s = new StatementAST((Expr*)$3, (Block*)$5); $$ = s; }
+statement: block { StatementAST *s = new (ps->nodes) StatementAST(llvm::cast<Block>($1)); $$ = s; }
+	| methodCall T_SEMICOLON { StatementAST *s = new (ps->nodes) StatementAST(llvm::cast<MethodCallAST>($1)); $$ = s; }
+	| assign T_SEMICOLON { StatementAST *s = new (ps->nodes) StatementAST(llvm::cast<Assign>($1)); $$ = s; }
+	| T_IF T_LPAREN expr T_RPAREN block { StatementAST *s = new (ps->nodes) StatementAST(llvm::cast<Expr>($3), llvm::cast<Block>($5), (Block*)NULL); $$ = s; }
+	| T_IF T_LPAREN expr T_RPAREN block T_ELSE block { StatementAST *s = new (ps->nodes) StatementAST(llvm::cast<Expr>($3), llvm::cast<Block>($5), llvm::cast<Block>($7)); $$ = s; }	
+	| T_WHILE T_LPAREN expr T_RPAREN block { StatementAST *s = new (ps->nodes) StatementAST(llvm::cast<Expr>($3), llvm::cast<Block>($5)); $$ = s; }
 	| T_FOR T_LPAREN assignList T_SEMICOLON expr T_SEMICOLON assignList T_RPAREN block {
-		StatementAST *s = new StatementAST((decafStmtList*)$3, (Expr*)$5, (decafStmtList*)$7, (Block*)$9);
+		StatementAST *s = new (ps->nodes) StatementAST(llvm::cast<decafStmtList>($3), llvm::cast<Expr>($5), llvm::cast<decafStmtList>($7), llvm::cast<Block>($9));
 		$$ = s;
 	}
-	| T_RETURN T_LPAREN expr T_RPAREN T_SEMICOLON { StatementAST *s = new StatementAST((Expr*)$3); $$ = s; }
+	| T_RETURN T_LPAREN expr T_RPAREN T_SEMICOLON { StatementAST *s = new (ps->nodes) StatementAST(llvm::cast<Expr>($3)); $$ = s; }
 	| T_RETURN T_LPAREN T_RPAREN T_SEMICOLON {
-		decafStmtList *dsl = new decafStmtList();
-		StatementAST *s = new StatementAST("return",dsl); $$ = s;
+		decafStmtList *dsl = new (ps->nodes) decafStmtList();
+		StatementAST *s = new (ps->nodes) StatementAST(VoidReturnStmtNode, dsl); $$ = s;
 	}
 	| T_RETURN T_SEMICOLON {
-		decafStmtList *dsl = new decafStmtList();
-		StatementAST *s = new StatementAST("return",dsl); $$ = s; }
-	| T_BREAK T_SEMICOLON { StatementAST *s = new StatementAST("break"); $$ = s; }
-	| T_CONTINUE T_SEMICOLON { StatementAST *s = new StatementAST("continue"); $$ = s; }
+		decafStmtList *dsl = new (ps->nodes) decafStmtList();
+		StatementAST *s = new (ps->nodes) StatementAST(VoidReturnStmtNode, dsl); $$ = s; }
+	| T_BREAK T_SEMICOLON { StatementAST *s = new (ps->nodes) StatementAST(BreakStmtNode); $$ = s; }
+	| T_CONTINUE T_SEMICOLON { StatementAST *s = new (ps->nodes) StatementAST(ContinueStmtNode); $$ = s; }
 	;
 
-varDecls: varDecl varDecls {
-		decafStmtList *dsl = (decafStmtList*)$2;
-        dsl->push_front((decafStmtList*)$1);
+varDecls: varDecls varDecl {
+		decafStmtList *dsl = llvm::cast<decafStmtList>($1);
+        dsl->push_back(llvm::cast<decafStmtList>($2));
         $$ = dsl; 
 	}
-	| { decafStmtList *dsl = new decafStmtList(); $$ = dsl; }
+	| { decafStmtList *dsl = new (ps->nodes) decafStmtList(); $$ = dsl; }
 	;	
 	
 varDecl: T_VAR idList type T_SEMICOLON {
-        decafStmtList *dsl = new decafStmtList();
-        string curr_id;
+        decafStmtList *dsl = new (ps->nodes) decafStmtList();
+        atom curr_id;
         StringList *sl = (StringList*)$2;
-        list<string> sList = sl->getList();
-        DecafTypeAST *d = (DecafTypeAST*)$3;
-        for(list<string>::const_iterator iter = sList.begin(); iter != sList.end(); ++iter){
+        llvm::ArrayRef<atom> sList = sl->getList();
+        DecafTypeAST *d = llvm::cast<DecafTypeAST>($3);
+        for(llvm::ArrayRef<atom>::iterator iter = sList.begin(); iter != sList.end(); ++iter){
             curr_id = *iter;
-            dsl->push_back(new TypedSymbolAST(curr_id, (DecafTypeAST*)$3));
+            dsl->push_back(new (ps->nodes) TypedSymbolAST(curr_id, llvm::cast<DecafTypeAST>($3)));
             //enter_symtbl(curr_id, d -> str(), lineno);
         }
         $$ = dsl;   
@@ -503,79 +478,415 @@ varDecl: T_VAR idList type T_SEMICOLON {
 
 /* UNARY OPS */
 
-arrayType: T_LSB T_INTCONSTANT T_RSB type {FieldSize *fs = new FieldSize($2, (DecafTypeAST*)$4); $$ = fs; }
+arrayType: T_LSB T_INTCONSTANT T_RSB type {FieldSize *fs = new (ps->nodes) FieldSize($2, llvm::cast<DecafTypeAST>($4)); $$ = fs; }
     ;
 
-externType: T_STRINGTYPE { ExternTypeAST *et = new ExternTypeAST("string"); $$ = et; }
+externType: T_STRINGTYPE { ExternTypeAST *et = new (ps->nodes) ExternTypeAST(StringType); $$ = et; }
     | type { 
-        ExternTypeAST *et = new ExternTypeAST((DecafTypeAST*)$1); 
+        ExternTypeAST *et = new (ps->nodes) ExternTypeAST(llvm::cast<DecafTypeAST>($1)); 
         $$ = et;
     }
     ;
-methodType: T_VOID { MethodTypeAST *mt = new MethodTypeAST("void"); $$ = mt;}
-    | type { MethodTypeAST *mt = new MethodTypeAST((DecafTypeAST*)$1); $$ = mt; }
+methodType: T_VOID { MethodTypeAST *mt = new (ps->nodes) MethodTypeAST(VoidType); $$ = mt;}
+    | type { MethodTypeAST *mt = new (ps->nodes) MethodTypeAST(llvm::cast<DecafTypeAST>($1)); $$ = mt; }
     ;
-type: T_INTTYPE { DecafTypeAST *dt = new DecafTypeAST("int"); $$ = dt;}
-    | T_BOOLTYPE { DecafTypeAST *dt = new DecafTypeAST("bool"); $$ = dt;}
+type: T_INTTYPE { DecafTypeAST *dt = new (ps->nodes) DecafTypeAST(IntType); $$ = dt;}
+    | T_BOOLTYPE { DecafTypeAST *dt = new (ps->nodes) DecafTypeAST(BoolType); $$ = dt;}
 	;
 
 
-constant : T_INTCONSTANT { Expr *c = new Expr($1); $$ = c;}
+constant : T_INTCONSTANT { Expr *c = new (ps->nodes) Expr($1); $$ = c;}
     | T_CHARCONSTANT { 
+        const string &lit = atoms.spelling($1);
         char ch;
-        if($1->at(1) == '\\'){
-            if($1->at(2) == 'n'){
+        if(lit.at(1) == '\\'){
+            if(lit.at(2) == 'n'){
                 ch = '\n';
-            }else if($1->at(2) == 'r'){
+            }else if(lit.at(2) == 'r'){
                 ch = '\r';
-            }else if($1->at(2) == 't'){
+            }else if(lit.at(2) == 't'){
                 ch = '\t';
-            }else if($1->at(2) == 'v'){
+            }else if(lit.at(2) == 'v'){
                 ch = '\v';
-            }else if($1->at(2) == 'f'){
+            }else if(lit.at(2) == 'f'){
                 ch = '\f';
-            }else if($1->at(2) == 'a'){
+            }else if(lit.at(2) == 'a'){
                 ch = '\a';
-            }else if($1->at(2) == 'b'){
+            }else if(lit.at(2) == 'b'){
                 ch = '\b';
-            }else if($1->at(2) == '\\'){
+            }else if(lit.at(2) == '\\'){
                 ch = '\\';
-            }else if($1->at(2) == '\''){
+            }else if(lit.at(2) == '\''){
                 ch = '\'';
-            }else if($1->at(2) == '"'){
+            }else if(lit.at(2) == '"'){
                 ch = '\"';
             }
         }else{
-            ch = $1->at(1);
+            ch = lit.at(1);
         }
-        Expr *c = new Expr(ch); $$ = c;
+        Expr *c = new (ps->nodes) Expr(ch); $$ = c;
     }
 	| boolConstant { $$ = $1; }
 	;
 
-boolConstant: T_TRUE { Expr *c = new Expr(true);$$ = c;}
-	| T_FALSE { Expr *c = new Expr(false);  $$ = c;}
+boolConstant: T_TRUE { Expr *c = new (ps->nodes) Expr(true);$$ = c;}
+	| T_FALSE { Expr *c = new (ps->nodes) Expr(false);  $$ = c;}
 	;
 
 %%
 
-int main() {
-  // initialize LLVM
-  llvm::LLVMContext &Context = llvm::getGlobalContext();
-  // Make the module, which holds all the code.
-  TheModule = new llvm::Module("Test", Context);
+// time the printer, which visits every node and every child list
+static void bench_walk(ProgramAST *prog, int reps) {
+  size_t chars = 0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 0; i < reps; i++) {
+    ostringstream os;
+    prog->print(os);
+    chars += os.tellp();
+  }
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "reps " << reps << " chars " << chars << endl;
+  cout << "walk " << secs << "s " << secs / reps * 1e6 << " us/walk" << endl;
+}
+
+// time full-tree walks through the switch-based visitor layer
+static void bench_visit(ProgramAST *prog, int reps) {
+  size_t nodes = 0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 0; i < reps; i++) {
+    node_counter counter;
+    counter.walk(prog);
+    nodes += counter.total;
+  }
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "reps " << reps << " nodes " << nodes / reps << endl;
+  cout << "visit " << secs << "s " << secs / reps * 1e6 << " us/walk " << nodes / secs / 1e6 << " Mnodes/s" << endl;
+}
+
+// time codegen for the whole program, each rep through a fresh context;
+// with a pool, method bodies are generated in parallel. Above -O0 the
+// pass pipeline is timed separately.
+static void bench_codegen(ProgramAST *prog, thread_pool &pool, const compile_options &opts, int reps) {
+  size_t functions = 0, instructions = 0;
+  double secs = 0, optSecs = 0;
+  for (int i = 0; i < reps; i++) {
+    llvm::LLVMContext context;
+    codegen_context cx(context, "Test");
+    configure_codegen(cx, opts);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (opts.parallel_codegen)
+      codegen_parallel(prog, pool, cx);
+    else
+      prog->Codegen(cx);
+    chrono::steady_clock::time_point generated = chrono::steady_clock::now();
+    optimize_module(cx.TheModule, opts.opt_level);
+    secs += chrono::duration<double>(generated - start).count();
+    optSecs += chrono::duration<double>(chrono::steady_clock::now() - generated).count();
+    functions = cx.TheModule->size();
+    instructions = 0;
+    for (auto &f : *cx.TheModule)
+      for (auto &bb : f)
+        instructions += bb.size();
+  }
+  cout << "reps " << reps << " functions " << functions << " instructions " << instructions << endl;
+  cout << "codegen " << secs << "s " << secs / reps * 1e3 << " ms/rep" << endl;
+  if (opts.opt_level > 0)
+    cout << "optimize -O" << opts.opt_level << " " << optSecs << "s " << optSecs / reps * 1e3 << " ms/rep" << endl;
+}
+
+// time the semantic checks over every method body on pool
+static void bench_check(ProgramAST *prog, thread_pool &pool, int reps) {
+  size_t diags = 0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 0; i < reps; i++)
+    diags += check_methods(prog, pool).size();
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "reps " << reps << " jobs " << pool.size() << " diagnostics " << diags / reps << endl;
+  cout << "check " << secs << "s " << secs / reps * 1e3 << " ms/rep" << endl;
+}
+
+static void usage(const char *prog) {
+  cerr << "usage: " << prog << " [options] [file.decaf]" << endl;
+  cerr << "  -fast-scan      use the hand-written scanner instead of flex" << endl;
+  cerr << "  -bench-scan=N   time both scanners over the file N times, then exit" << endl;
+  cerr << "  -bench-walk=N   time N walks over the parsed AST, then exit" << endl;
+  cerr << "  -bench-visit=N  time N visitor walks over the parsed AST, then exit" << endl;
+  cerr << "  -bench-codegen=N  time N rounds of codegen for the whole program, then exit" << endl;
+  cerr << "  -bench-check=N  time N rounds of semantic checks, then exit" << endl;
+  cerr << "  -check          only resolve names and type check, generating no code" << endl;
+  cerr << "  -jobs=N         check method bodies on N threads, 0 for one per core" << endl;
+  cerr << "                  (default: 1, or one per core with -parallel-codegen)" << endl;
+  cerr << "  -parallel-codegen  also generate method bodies on the -jobs threads" << endl;
+  cerr << "  -O0 .. -O3      optimization level of the generated code (default: -O0)" << endl;
+  cerr << "  -c              write a native object file instead of printing the IR" << endl;
+  cerr << "  -o FILE         name of the object file (default: the source file's" << endl;
+  cerr << "                  name with .o in place of .decaf)" << endl;
+  cerr << "  -run            compile in memory and run the program's main, reading" << endl;
+  cerr << "                  its input from stdin, instead of printing the IR" << endl;
+  cerr << "  -bounds-check=off|always|elide  check array indexes never, on every access," << endl;
+  cerr << "                  or except where a loop proves them in range (default: elide)" << endl;
+  cerr << "  -no-fold        generate expressions as written, without constant folding" << endl;
+  cerr << "  -ssa            keep locals and parameters in registers, building SSA" << endl;
+  cerr << "                  during codegen instead of using stack slots" << endl;
+  cerr << "  -stats          report AST arena use and heap allocations, and peak RSS" << endl;
+  cerr << "  -heap-ast       allocate each AST node separately instead of from the arena" << endl;
+  cerr << "  -print-ast      print the AST before generating code" << endl;
+  cerr << "  -emit-ast=FILE  also write the parsed AST to FILE in binary form" << endl;
+  cerr << "  -load-ast=FILE  read a binary AST from FILE instead of parsing source" << endl;
+  cerr << "  -watch          recompile the file whenever it changes, regenerating" << endl;
+  cerr << "                  only the methods and fields that were edited" << endl;
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  parse_state ps;
+  const char *path = NULL;
+  int benchScanReps = 0;
+  int benchWalkReps = 0;
+  int benchVisitReps = 0;
+  int benchCodegenReps = 0;
+  int benchCheckReps = 0;
+  compile_options opts;
+  // threads for the pool; -1 until -jobs says otherwise
+  int jobs = -1;
+  bool checkOnly = false;
+  bool watch = false;
+  bool run = false;
+  bool emitObject = false;
+  string objectPath;
+  bool stats = false;
+  const char *emitAST = NULL;
+  const char *loadAST = NULL;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "-fast-scan") {
+      opts.fast_scan = true;
+    } else if (arg.compare(0, 12, "-bench-scan=") == 0) {
+      benchScanReps = atoi(arg.c_str() + 12);
+    } else if (arg.compare(0, 12, "-bench-walk=") == 0) {
+      benchWalkReps = atoi(arg.c_str() + 12);
+    } else if (arg.compare(0, 13, "-bench-visit=") == 0) {
+      benchVisitReps = atoi(arg.c_str() + 13);
+    } else if (arg.compare(0, 15, "-bench-codegen=") == 0) {
+      benchCodegenReps = atoi(arg.c_str() + 15);
+    } else if (arg.compare(0, 13, "-bench-check=") == 0) {
+      benchCheckReps = atoi(arg.c_str() + 13);
+    } else if (arg.compare(0, 6, "-jobs=") == 0) {
+      jobs = atoi(arg.c_str() + 6);
+    } else if (arg == "-stats") {
+      stats = true;
+    } else if (arg == "-heap-ast") {
+      ps.nodes.set_bump(false);
+    } else if (arg == "-watch") {
+      watch = true;
+    } else if (arg == "-parallel-codegen") {
+      opts.parallel_codegen = true;
+    } else if (arg == "-c") {
+      emitObject = true;
+    } else if (arg == "-o") {
+      if (++i == argc)
+        usage(argv[0]);
+      objectPath = argv[i];
+    } else if (arg == "-run" || arg == "--run") {
+      run = true;
+    } else if (arg == "-bounds-check=off") {
+      opts.bounds = BoundsOff;
+    } else if (arg == "-bounds-check=always") {
+      opts.bounds = BoundsAlways;
+    } else if (arg == "-bounds-check=elide") {
+      opts.bounds = BoundsElide;
+    } else if (arg == "-no-fold") {
+      opts.fold = false;
+    } else if (arg == "-ssa") {
+      opts.ssa = true;
+    } else if (arg.size() == 3 && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3') {
+      opts.opt_level = arg[2] - '0';
+    } else if (arg == "-check") {
+      checkOnly = true;
+    } else if (arg == "-print-ast") {
+      printAST = true;
+    } else if (arg.compare(0, 10, "-emit-ast=") == 0) {
+      emitAST = argv[i] + 10;
+    } else if (arg.compare(0, 10, "-load-ast=") == 0) {
+      loadAST = argv[i] + 10;
+    } else if (arg[0] == '-' && arg.size() > 1) {
+      usage(argv[0]);
+    } else {
+      path = argv[i];
+    }
+  }
+
+  if (emitObject && objectPath.empty()) {
+    if (path == NULL)
+      usage(argv[0]);
+    // foo/bar.decaf makes bar.o, as cc -c does
+    objectPath = path;
+    objectPath.erase(0, objectPath.rfind('/') + 1);
+    if (objectPath.size() > 6 && objectPath.compare(objectPath.size() - 6, 6, ".decaf") == 0)
+      objectPath.erase(objectPath.size() - 6);
+    objectPath += ".o";
+  }
+
+  source_file src;
+  if (path != NULL) {
+    try {
+      src.open(path);
+    }
+    catch (std::runtime_error &e) {
+      cerr << "error: " << e.what() << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  // small programs check faster than threads start, so only go wide when
+  // asked to
+  opts.jobs = jobs >= 0 ? jobs : opts.parallel_codegen ? 0 : 1;
+  ps.fast_scan = opts.fast_scan;
+  if (benchScanReps > 0) {
+    if (path == NULL)
+      usage(argv[0]);
+    bench_scanners(src, benchScanReps);
+    return EXIT_SUCCESS;
+  }
+
+  if (watch) {
+    if (path == NULL)
+      usage(argv[0]);
+    src.close();
+    return watch_source(path, opts);
+  }
   // set up symbol table
   // set up dummy main function
     //TheFunction = gen_main_def();
   // parse the input and create the abstract syntax tree
-  int retval = yyparse();
+  int retval;
+  if (loadAST != NULL) {
+    try {
+      source_file bin;
+      bin.open(loadAST);
+      ps.prog = read_ast(bin.data(), bin.size(), ps.nodes);
+      retval = 0;
+    }
+    catch (std::runtime_error &e) {
+      cerr << "error: " << loadAST << ": " << e.what() << endl;
+      exit(EXIT_FAILURE);
+    }
+  } else if (path != NULL) {
+    retval = parse_decaf(src, &ps);
+  } else {
+    retval = parse_decaf(stdin, &ps);
+  }
+  if (retval == 0 && ps.prog != NULL && emitAST != NULL) {
+    ofstream out(emitAST, ios::binary);
+    write_ast(out, ps.prog);
+    if (!out.flush()) {
+      cerr << "error: cannot write " << emitAST << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (retval == 0 && ps.prog != NULL && benchWalkReps > 0) {
+    bench_walk(ps.prog, benchWalkReps);
+    return EXIT_SUCCESS;
+  }
+  if (retval == 0 && ps.prog != NULL && benchVisitReps > 0) {
+    bench_visit(ps.prog, benchVisitReps);
+    return EXIT_SUCCESS;
+  }
+  thread_pool pool(opts.jobs);
+  if (checkOnly) {
+    if (retval != 0 || ps.prog == NULL)
+      return EXIT_FAILURE;
+    try {
+      resolve_names(ps.prog);
+    }
+    catch (std::runtime_error &e) {
+      cout << "semantic error: " << e.what() << endl;
+      return EXIT_FAILURE;
+    }
+    return check_program(ps.prog, pool) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  // initialize LLVM
+  llvm::LLVMContext Context;
+  // Make the module, which holds all the code.
+  codegen_context cx(Context, "Test");
+  if (retval == 0 && ps.prog != NULL && benchCheckReps > 0) {
+    try {
+      resolve_names(ps.prog);
+      bench_check(ps.prog, pool, benchCheckReps);
+    }
+    catch (std::runtime_error &e) {
+      cout << "semantic error: " << e.what() << endl;
+      exit(EXIT_FAILURE);
+    }
+    return EXIT_SUCCESS;
+  }
+  if (retval == 0 && ps.prog != NULL && benchCodegenReps > 0) {
+    try {
+      if (!prepare_program(ps.prog, ps.nodes, pool, opts))
+        exit(EXIT_FAILURE);
+      bench_codegen(ps.prog, pool, opts, benchCodegenReps);
+    }
+    catch (std::runtime_error &e) {
+      cout << "semantic error: " << e.what() << endl;
+      exit(EXIT_FAILURE);
+    }
+    return EXIT_SUCCESS;
+  }
+  if (retval == 0 && ps.prog != NULL) {
+    if (printAST) {
+      ps.prog->print(cout);
+      cout << endl;
+    }
+    try {
+      if (!prepare_program(ps.prog, ps.nodes, pool, opts))
+        exit(EXIT_FAILURE);
+      generate_program(ps.prog, pool, cx, opts);
+    } 
+    catch (std::runtime_error &e) {
+      cout << "semantic error: " << e.what() << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  size_t astNodes = ps.nodes.object_count(), astBytes = ps.nodes.byte_count(), astBlocks = ps.nodes.block_count(), astAllocations = ps.nodes.allocation_count();
+  ps.nodes.release();
+  ps.prog = NULL;
   // remove symbol table
   // Finish off the main function. (see the WARNING above)
   // return 0 from main, which is EXIT_SUCCESS
   //Builder.CreateRet(llvm::ConstantInt::get(llvm::getGlobalContext(), llvm::APInt(32, 0)));
   // Validate the generated code, checking for consistency.
     //verifyFunction(*TheFunction);
-  // Print out all of the generated code to stderr
-  TheModule->dump();
+  if (run && retval == 0) {
+    try {
+      return run_module(cx.release(), opts.opt_level);
+    }
+    catch (std::runtime_error &e) {
+      cerr << "error: " << e.what() << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (emitObject && retval == 0) {
+    try {
+      emit_object(cx.TheModule, objectPath.c_str(), opts.opt_level);
+    }
+    catch (std::runtime_error &e) {
+      cerr << "error: " << e.what() << endl;
+      exit(EXIT_FAILURE);
+    }
+  } else {
+    // Print out all of the generated code to stderr
+    cx.TheModule->dump();
+  }
+  if (stats) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    long peakKB = ru.ru_maxrss / 1024;
+#else
+    long peakKB = ru.ru_maxrss;
+#endif
+    cout << "ast nodes " << astNodes << " bytes " << astBytes << " heap blocks " << astBlocks << endl;
+    cout << "heap allocations " << astAllocations << endl;
+    cout << "peak rss " << peakKB << " KB" << endl;
+  }
   return(retval >= 1 ? EXIT_FAILURE : EXIT_SUCCESS);
 }
\ No newline at end of file
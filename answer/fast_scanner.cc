@@ -0,0 +1,401 @@
+#include <string>
+#include <cstring>
+#include <iostream>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// decafscanner - hand-written replacement for the flex scanner in
+// decafcomp.lex. It returns the same token codes, values and locations as
+// the flex rules (including their quirks: comments stop at '(' or ')' and
+// do not bump lineno, strings may not contain parens) so the two can be
+// swapped freely. Runs of whitespace, identifier characters and comment or
+// string bodies are skipped a vector at a time when SSE2 or AVX2 is on.
+//
+// This file is included into the scanner translation unit, after
+// decafcomp.tab.h and intConst().
+
+enum char_class {
+	C_BAD, C_SPACE, C_IDENT, C_DIGIT, C_QUOTE, C_TICK, C_SLASH,
+	C_LT, C_GT, C_EQ, C_BANG, C_PIPE, C_AMP, C_SINGLE
+};
+
+struct scanner_tables {
+	unsigned char cclass[256];
+	short single[256];
+	bool space[256];
+	bool ident[256];
+
+	scanner_tables(){
+		memset(cclass, C_BAD, sizeof(cclass));
+		memset(single, 0, sizeof(single));
+		memset(space, 0, sizeof(space));
+		memset(ident, 0, sizeof(ident));
+		const char *spaces = "\t\r\a\v\b \n";
+		for(const char *c = spaces; *c; c++){
+			cclass[(unsigned char) *c] = C_SPACE;
+			space[(unsigned char) *c] = true;
+		}
+		for(int c = 'a'; c <= 'z'; c++){ cclass[c] = C_IDENT; ident[c] = true; }
+		for(int c = 'A'; c <= 'Z'; c++){ cclass[c] = C_IDENT; ident[c] = true; }
+		for(int c = '0'; c <= '9'; c++){ cclass[c] = C_DIGIT; ident[c] = true; }
+		cclass['_'] = C_IDENT; ident['_'] = true;
+		cclass['"'] = C_QUOTE;
+		cclass['\''] = C_TICK;
+		cclass['/'] = C_SLASH;
+		cclass['<'] = C_LT;
+		cclass['>'] = C_GT;
+		cclass['='] = C_EQ;
+		cclass['!'] = C_BANG;
+		cclass['|'] = C_PIPE;
+		cclass['&'] = C_AMP;
+		set_single('+', T_PLUS);
+		set_single('-', T_MINUS);
+		set_single('*', T_MULT);
+		set_single('%', T_MOD);
+		set_single('.', T_DOT);
+		set_single('{', T_LCB);
+		set_single('(', T_LPAREN);
+		set_single('[', T_LSB);
+		set_single('}', T_RCB);
+		set_single(')', T_RPAREN);
+		set_single(']', T_RSB);
+		set_single(';', T_SEMICOLON);
+		set_single(',', T_COMMA);
+	}
+	void set_single(char c, short tok){
+		cclass[(unsigned char) c] = C_SINGLE;
+		single[(unsigned char) c] = tok;
+	}
+};
+
+static const scanner_tables scan_tables;
+
+// perfect hash over the keywords: (first char + 22 * length) & 31 is
+// distinct for every keyword, so one probe and one memcmp decide it
+struct keyword_entry {
+	const char *name;
+	int len;
+	int token;
+};
+
+static const keyword_entry keyword_table[32] = {
+	{ "",         0, 0             },
+	{ "",         0, 0             },
+	{ "",         0, 0             },
+	{ "",         0, 0             },
+	{ "",         0, 0             },
+	{ "while",    5, T_WHILE       },
+	{ "null",     4, T_NULL        },
+	{ "",         0, 0             },
+	{ "for",      3, T_FOR         },
+	{ "extern",   6, T_EXTERN      },
+	{ "package",  7, T_PACKAGE     },
+	{ "int",      3, T_INTTYPE     },
+	{ "true",     4, T_TRUE        },
+	{ "",         0, 0             },
+	{ "void",     4, T_VOID        },
+	{ "",         0, 0             },
+	{ "break",    5, T_BREAK       },
+	{ "",         0, 0             },
+	{ "",         0, 0             },
+	{ "continue", 8, T_CONTINUE    },
+	{ "false",    5, T_FALSE       },
+	{ "if",       2, T_IF          },
+	{ "return",   6, T_RETURN      },
+	{ "string",   6, T_STRINGTYPE  },
+	{ "var",      3, T_VAR         },
+	{ "",         0, 0             },
+	{ "bool",     4, T_BOOLTYPE    },
+	{ "",         0, 0             },
+	{ "",         0, 0             },
+	{ "else",     4, T_ELSE        },
+	{ "func",     4, T_FUNC        },
+	{ "",         0, 0             },
+};
+
+static inline int keyword_token(const char *s, int len){
+	const keyword_entry &k = keyword_table[((unsigned char) s[0] + 22 * len) & 31];
+	if(k.len == len && memcmp(k.name, s, len) == 0)
+		return k.token;
+	return 0;
+}
+
+static inline bool is_escape(char c){
+	return c != 0 && strchr("abtnvfr\\'\"", c) != NULL;
+}
+
+#if defined(__AVX2__)
+#define DECAF_SIMD 1
+typedef __m256i vec;
+static const int vec_bytes = 32;
+static inline vec vload(const char *p){ return _mm256_loadu_si256((const __m256i *) p); }
+static inline vec vsplat(char c){ return _mm256_set1_epi8(c); }
+static inline vec veq(vec a, char c){ return _mm256_cmpeq_epi8(a, vsplat(c)); }
+static inline vec vor(vec a, vec b){ return _mm256_or_si256(a, b); }
+static inline vec vand(vec a, vec b){ return _mm256_and_si256(a, b); }
+static inline vec vrange(vec a, char lo, char hi){
+	return vand(_mm256_cmpgt_epi8(a, vsplat(lo - 1)), _mm256_cmpgt_epi8(vsplat(hi + 1), a));
+}
+static inline unsigned int vmask(vec a){ return (unsigned int) _mm256_movemask_epi8(a); }
+static const unsigned int vfull = 0xffffffffu;
+#elif defined(__SSE2__)
+#define DECAF_SIMD 1
+typedef __m128i vec;
+static const int vec_bytes = 16;
+static inline vec vload(const char *p){ return _mm_loadu_si128((const __m128i *) p); }
+static inline vec vsplat(char c){ return _mm_set1_epi8(c); }
+static inline vec veq(vec a, char c){ return _mm_cmpeq_epi8(a, vsplat(c)); }
+static inline vec vor(vec a, vec b){ return _mm_or_si128(a, b); }
+static inline vec vand(vec a, vec b){ return _mm_and_si128(a, b); }
+static inline vec vrange(vec a, char lo, char hi){
+	return vand(_mm_cmpgt_epi8(a, vsplat(lo - 1)), _mm_cmplt_epi8(a, vsplat(hi + 1)));
+}
+static inline unsigned int vmask(vec a){ return (unsigned int) _mm_movemask_epi8(a); }
+static const unsigned int vfull = 0xffffu;
+#endif
+
+// skip [\t\r\a\v\b \n]*, counting newlines
+static inline const char *skip_space(const char *p, const char *end, int &lines){
+#ifdef DECAF_SIMD
+	while(end - p >= vec_bytes){
+		vec v = vload(p);
+		unsigned int nl = vmask(veq(v, '\n'));
+		unsigned int stop = ~vmask(vor(vor(vrange(v, '\a', '\v'), veq(v, '\r')), veq(v, ' '))) & vfull;
+		if(stop){
+			int k = __builtin_ctz(stop);
+			lines += __builtin_popcount(nl & ((1u << k) - 1));
+			return p + k;
+		}
+		lines += __builtin_popcount(nl);
+		p += vec_bytes;
+	}
+#endif
+	while(p < end && scan_tables.space[(unsigned char) *p]){
+		if(*p == '\n')
+			lines++;
+		p++;
+	}
+	return p;
+}
+
+// skip [a-zA-Z_0-9]*
+static inline const char *skip_ident(const char *p, const char *end){
+#ifdef DECAF_SIMD
+	while(end - p >= vec_bytes){
+		vec v = vload(p);
+		vec id = vor(vor(vrange(v, 'a', 'z'), vrange(v, 'A', 'Z')), vor(vrange(v, '0', '9'), veq(v, '_')));
+		unsigned int stop = ~vmask(id) & vfull;
+		if(stop)
+			return p + __builtin_ctz(stop);
+		p += vec_bytes;
+	}
+#endif
+	while(p < end && scan_tables.ident[(unsigned char) *p])
+		p++;
+	return p;
+}
+
+// find the first '\n', '(' or ')' - the end of a comment body
+static inline const char *find_comment_end(const char *p, const char *end){
+#ifdef DECAF_SIMD
+	while(end - p >= vec_bytes){
+		vec v = vload(p);
+		unsigned int hit = vmask(vor(veq(v, '\n'), vrange(v, '(', ')')));
+		if(hit)
+			return p + __builtin_ctz(hit);
+		p += vec_bytes;
+	}
+#endif
+	while(p < end && *p != '\n' && *p != '(' && *p != ')')
+		p++;
+	return p;
+}
+
+// find the first '"', '\\', '\n', '(' or ')' - the end of a run of plain
+// string constant characters
+static inline const char *find_string_stop(const char *p, const char *end){
+#ifdef DECAF_SIMD
+	while(end - p >= vec_bytes){
+		vec v = vload(p);
+		unsigned int hit = vmask(vor(vor(veq(v, '"'), veq(v, '\\')), vor(veq(v, '\n'), vrange(v, '(', ')'))));
+		if(hit)
+			return p + __builtin_ctz(hit);
+		p += vec_bytes;
+	}
+#endif
+	while(p < end && *p != '"' && *p != '\\' && *p != '\n' && *p != '(' && *p != ')')
+		p++;
+	return p;
+}
+
+class decafscanner{
+
+public:
+	decafscanner(const char *src, size_t len, parse_state *state)
+		: base(src), cur(src), end(src + len), tok(src), toklen(0), ps(state) {}
+
+	int lex(YYSTYPE *lvalp, YYLTYPE *llocp){
+		for(;;){
+			const char *start = cur;
+			if(cur >= end){
+				set_token(llocp, start, 0);
+				return 0;
+			}
+			int c = (unsigned char) *cur;
+			switch(scan_tables.cclass[c]){
+			case C_SPACE:
+				cur = skip_space(cur, end, ps->lineno);
+				continue;
+			case C_IDENT: {
+				cur = skip_ident(cur + 1, end);
+				int len = cur - start;
+				int kw = keyword_token(start, len);
+				if(kw != 0)
+					return token(llocp, start, kw);
+				lvalp->aval = atoms.intern(start, len);
+				return token(llocp, start, T_ID);
+			}
+			case C_DIGIT:
+				return number(lvalp, llocp, start);
+			case C_QUOTE:
+				return string_constant(lvalp, llocp, start);
+			case C_TICK:
+				return char_constant(lvalp, llocp, start);
+			case C_SLASH:
+				if(cur + 1 < end && cur[1] == '/'){
+					const char *p = find_comment_end(cur + 2, end);
+					if(p < end && *p == '\n'){
+						cur = p + 1;
+						ps->tokenpos++;
+						continue;
+					}
+				}
+				cur++;
+				return token(llocp, start, T_DIV);
+			case C_LT:
+				return pair(llocp, start, '<', T_LEFTSHIFT, '=', T_LEQ, T_LT);
+			case C_GT:
+				return pair(llocp, start, '>', T_RIGHTSHIFT, '=', T_GEQ, T_GT);
+			case C_EQ:
+				return pair(llocp, start, '=', T_EQ, 0, 0, T_ASSIGN);
+			case C_BANG:
+				return pair(llocp, start, '=', T_NEQ, 0, 0, T_NOT);
+			case C_PIPE:
+				return pair(llocp, start, '|', T_OR, 0, 0, -1);
+			case C_AMP:
+				return pair(llocp, start, '&', T_AND, 0, 0, -1);
+			case C_SINGLE:
+				cur++;
+				return token(llocp, start, scan_tables.single[c]);
+			default:
+				return bad_char(llocp, start);
+			}
+		}
+	}
+
+	// text of the most recent token, for error messages
+	string text(){
+		return string(tok, toklen);
+	}
+
+private:
+	void set_token(YYLTYPE *llocp, const char *start, int len){
+		tok = start;
+		toklen = len;
+		llocp->lineno = ps->lineno;
+		llocp->offset = start - base;
+		llocp->length = len;
+	}
+
+	int token(YYLTYPE *llocp, const char *start, int t){
+		set_token(llocp, start, cur - start);
+		ps->tokenpos++;
+		return t;
+	}
+
+	int bad_char(YYLTYPE *llocp, const char *start){
+		cur = start + 1;
+		set_token(llocp, start, 1);
+		cerr << "Error: unexpected character in input" << endl;
+		return -1;
+	}
+
+	// one- or two-character operator; a missing single form is an error
+	int pair(YYLTYPE *llocp, const char *start, char c1, int t1, char c2, int t2, int single){
+		if(cur + 1 < end && cur[1] == c1){
+			cur += 2;
+			return token(llocp, start, t1);
+		}
+		if(c2 != 0 && cur + 1 < end && cur[1] == c2){
+			cur += 2;
+			return token(llocp, start, t2);
+		}
+		if(single < 0)
+			return bad_char(llocp, start);
+		cur++;
+		return token(llocp, start, single);
+	}
+
+	int number(YYSTYPE *lvalp, YYLTYPE *llocp, const char *start){
+		const char *p = start + 1;
+		if(*start == '0' && p + 1 < end && (*p == 'x' || *p == 'X') && isxdigit((unsigned char) p[1])){
+			p += 2;
+			while(p < end && isxdigit((unsigned char) *p))
+				p++;
+		}else{
+			while(p < end && *p >= '0' && *p <= '9')
+				p++;
+		}
+		cur = p;
+		// intConst needs a terminated string and the source may not have one
+		string digits(start, p - start);
+		lvalp->ival = intConst(&digits[0]);
+		return token(llocp, start, T_INTCONSTANT);
+	}
+
+	int string_constant(YYSTYPE *lvalp, YYLTYPE *llocp, const char *start){
+		const char *p = start + 1;
+		for(;;){
+			p = find_string_stop(p, end);
+			if(p >= end)
+				return bad_char(llocp, start);
+			if(*p == '"')
+				break;
+			if(*p == '\\' && p + 1 < end && is_escape(p[1])){
+				p += 2;
+				continue;
+			}
+			return bad_char(llocp, start);
+		}
+		cur = p + 1;
+		lvalp->aval = atoms.intern(start, cur - start);
+		return token(llocp, start, T_STRINGCONSTANT);
+	}
+
+	int char_constant(YYSTYPE *lvalp, YYLTYPE *llocp, const char *start){
+		const char *p = start + 1;
+		if(p < end && *p == '\\'){
+			if(p + 2 < end && is_escape(p[1]) && p[2] == '\'')
+				cur = p + 3;
+			else
+				return bad_char(llocp, start);
+		}else if(p + 1 < end && *p != '\'' && p[1] == '\''){
+			cur = p + 2;
+		}else{
+			return bad_char(llocp, start);
+		}
+		lvalp->aval = atoms.intern(start, cur - start);
+		return token(llocp, start, T_CHARCONSTANT);
+	}
+
+	const char *base;
+	const char *cur;
+	const char *end;
+	const char *tok;
+	int toklen;
+	parse_state *ps;
+};
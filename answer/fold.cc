@@ -0,0 +1,243 @@
+#include "llvm/Support/Casting.h"
+#include <cstdint>
+
+using namespace std;
+
+// constant_folder - rewrites the method bodies of a checked program before
+// codegen. Constant subtrees of an Expr become one NumberExpr or BoolExpr,
+// computed as the generated code would: 32-bit wrapping arithmetic,
+// logical right shift. Division by zero, INT_MIN / -1 and shifts outside
+// 0..31 are left for run time. Identities drop the other operand (x*1,
+// x+0, x-0, x/1, x<<0, !!b, -(-x), true && b, false || b), and a constant
+// left side decides && and || outright. An operand whose value is thrown
+// away (x*0, b && false) is dropped only if it is pure. An if, while or
+// for whose condition folds to a constant keeps only the code that can
+// run. New nodes come from the program's arena and carry their type, as
+// the type checker would have set it.
+class constant_folder{
+
+public:
+	constant_folder(arena &a) : nodes(a) {}
+
+	void fold_method(MethodDecl *m){
+		fold_block(m->getBlock()->getStmts());
+	}
+
+private:
+	void fold_block(decafStmtList *stmts){
+		if(stmts == NULL)
+			return;
+		for(decafAST **i = stmts->begin(); i != stmts->end(); ){
+			decafAST *s = fold_statement(llvm::cast<StatementAST>(*i));
+			if(s == NULL){
+				i = stmts->erase(i);
+			}else{
+				*i++ = s;
+			}
+		}
+	}
+
+	// the statement to generate in place of s, or NULL if it does nothing
+	decafAST *fold_statement(StatementAST *s){
+		switch(s->getKind()){
+		case AssignStmtNode:
+			fold_assign(s->getAssign());
+			return s;
+		case CallStmtNode:
+			fold_call(s->getCall());
+			return s;
+		case ReturnStmtNode:
+			s->setValue(fold(s->getValue()));
+			return s;
+		case BlockStmtNode:
+			fold_block(s->getBlock()->getStmts());
+			return s;
+		case IfStmtNode: {
+			s->setCondition(fold(s->getCondition()));
+			fold_block(s->getThen()->getStmts());
+			if(s->getElse() != NULL)
+				fold_block(s->getElse()->getStmts());
+			Expr *c = s->getCondition();
+			if(c->getKind() != BoolExprNode)
+				return s;
+			Block *taken = c->getBool() ? s->getThen() : s->getElse();
+			return taken == NULL ? NULL : new (nodes) StatementAST(taken);
+		}
+		case WhileStmtNode:
+			s->setCondition(fold(s->getCondition()));
+			fold_block(s->getBody()->getStmts());
+			if(s->getCondition()->getKind() == BoolExprNode && !s->getCondition()->getBool())
+				return NULL;
+			return s;
+		case ForStmtNode:
+			for(auto a : s->getInit()->getList())
+				fold_assign(llvm::cast<Assign>(a));
+			s->setCondition(fold(s->getCondition()));
+			for(auto a : s->getStep()->getList())
+				fold_assign(llvm::cast<Assign>(a));
+			fold_block(s->getBody()->getStmts());
+			if(s->getCondition()->getKind() == BoolExprNode && !s->getCondition()->getBool()){
+				// only the initial assignments run
+				return new (nodes) StatementAST(new (nodes) Block(NULL, s->getInit()));
+			}
+			return s;
+		default:
+			return s;
+		}
+	}
+
+	void fold_assign(Assign *a){
+		if(a->getIndex() != NULL)
+			a->setIndex(fold(a->getIndex()));
+		a->setValue(fold(a->getValue()));
+	}
+
+	void fold_call(MethodCallAST *c){
+		for(auto arg : c->getArgs()->getList()){
+			MethodArg *ma = llvm::cast<MethodArg>(arg);
+			if(ma->getExpr() != NULL)
+				ma->setExpr(fold(ma->getExpr()));
+		}
+	}
+
+	// the folded form of e, which may be e itself, one of its operands or
+	// a new constant
+	Expr *fold(Expr *e){
+		switch(e->getKind()){
+		case RvalueExprNode: {
+			Rvalue *r = llvm::cast<Rvalue>(e->getRvalue()->getList()[0]);
+			if(r->getIndex() != NULL)
+				r->setIndex(fold(r->getIndex()));
+			return e;
+		}
+		case CallExprNode:
+			fold_call(e->getCall());
+			return e;
+		case UnaryExprNode:
+			return fold_unary(e);
+		case BinaryExprNode:
+			return fold_binary(e);
+		default:
+			return e;
+		}
+	}
+
+	Expr *fold_unary(Expr *e){
+		Expr *v = fold(e->getOperand());
+		e->setOperand(v);
+		UnaryOp op = e->getUnaryOp()->getOp();
+		if(op == Not && v->getKind() == BoolExprNode)
+			return boolean(!v->getBool());
+		if(op == UnaryMinus && v->getKind() == IntExprNode)
+			return integer(0u - (uint32_t) v->getInt());
+		// !!b and -(-x)
+		if(v->getKind() == UnaryExprNode && v->getUnaryOp()->getOp() == op)
+			return v->getOperand();
+		return e;
+	}
+
+	Expr *fold_binary(Expr *e){
+		Expr *l = fold(e->getLHS());
+		Expr *r = fold(e->getRHS());
+		e->setLHS(l);
+		e->setRHS(r);
+		BinaryOp op = e->getBinaryOp()->getOp();
+		if(op == And || op == Or){
+			// a constant left side decides whether the right side runs
+			bool shortValue = op == Or;
+			if(l->getKind() == BoolExprNode)
+				return l->getBool() == shortValue ? l : r;
+			if(r->getKind() == BoolExprNode)
+				return r->getBool() != shortValue ? l : l->pure() ? r : e;
+			return e;
+		}
+		if(l->getKind() == BoolExprNode && r->getKind() == BoolExprNode){
+			if(op != Eq && op != Neq)
+				return e;
+			return boolean((l->getBool() == r->getBool()) == (op == Eq));
+		}
+		if(l->getKind() == IntExprNode && r->getKind() == IntExprNode){
+			Expr *c = fold_constant(op, l->getInt(), r->getInt());
+			return c != NULL ? c : e;
+		}
+		if(r->getKind() == IntExprNode)
+			return fold_identity(e, op, l, r->getInt(), true);
+		if(l->getKind() == IntExprNode)
+			return fold_identity(e, op, r, l->getInt(), false);
+		return e;
+	}
+
+	// both operands are NumberExprs; NULL if the result is left to run time
+	Expr *fold_constant(BinaryOp op, int32_t l, int32_t r){
+		uint32_t ul = l, ur = r;
+		switch(op){
+		case Plus: return integer(ul + ur);
+		case Minus: return integer(ul - ur);
+		case Mult: return integer(ul * ur);
+		case Div:
+		case Mod:
+			if(r == 0 || (l == INT32_MIN && r == -1))
+				return NULL;
+			return integer(op == Div ? l / r : l % r);
+		case Leftshift:
+		case Rightshift:
+			if(r < 0 || r > 31)
+				return NULL;
+			return integer(op == Leftshift ? ul << r : ul >> r);
+		case Lt: return boolean(l < r);
+		case Gt: return boolean(l > r);
+		case Leq: return boolean(l <= r);
+		case Geq: return boolean(l >= r);
+		case Eq: return boolean(l == r);
+		case Neq: return boolean(l != r);
+		default: return NULL;
+		}
+	}
+
+	// one operand x is not constant and the other is the number k, on the
+	// right if right is set
+	Expr *fold_identity(Expr *e, BinaryOp op, Expr *x, int32_t k, bool right){
+		switch(op){
+		case Plus:
+			return k == 0 ? x : e;
+		case Minus:
+			return k == 0 && right ? x : e;
+		case Mult:
+			if(k == 1)
+				return x;
+			return k == 0 && x->pure() ? integer(0) : e;
+		case Div:
+			return k == 1 && right ? x : e;
+		case Mod:
+			return k == 1 && right && x->pure() ? integer(0) : e;
+		case Leftshift:
+		case Rightshift:
+			return k == 0 && right ? x : e;
+		default:
+			return e;
+		}
+	}
+
+	Expr *integer(uint32_t v){
+		Expr *e = new (nodes) Expr((int) v);
+		e->setType(IntType);
+		return e;
+	}
+	Expr *boolean(bool v){
+		Expr *e = new (nodes) Expr(v);
+		e->setType(BoolType);
+		return e;
+	}
+
+	arena &nodes;
+};
+
+// fold_program - fold the method bodies of a resolved, type checked
+// program, allocating what replaces them in nodes
+void fold_program(ProgramAST *prog, arena &nodes){
+	if(prog->getPackage() == NULL)
+		return;
+	constant_folder f(nodes);
+	for(auto m : prog->getPackage()->getMethods()->getList())
+		f.fold_method(llvm::cast<MethodDecl>(m));
+}
@@ -0,0 +1,65 @@
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/TargetSelect.h"
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// the runtime in decaf-stdlib.o, linked into the compiler itself
+extern "C" {
+	void print_int(int x);
+	void print_string(const char *s);
+	int read_int();
+}
+
+// run_module - compile m in-process with MCJIT and call its main, the way
+// llvm-run would after llvm-as, llc and gcc. Calls to the standard library
+// are bound to the copy linked into the compiler, and any other extern is
+// looked up in the compiler's own process. Takes ownership of m and
+// returns what main returned, or 0 if main returns nothing.
+int run_module(llvm::Module *m, unsigned optLevel){
+	unique_ptr<llvm::Module> owned(m);
+	// -O0 code may still have dead code after a return or an open block
+	finish_module(m);
+	llvm::Function *mainFn = m->getFunction("main");
+	if(mainFn == NULL || mainFn->isDeclaration() || mainFn->arg_size() != 0)
+		throw runtime_error("no main method to run");
+
+	llvm::InitializeNativeTarget();
+	llvm::InitializeNativeTargetAsmPrinter();
+	llvm::sys::DynamicLibrary::LoadLibraryPermanently(NULL);
+	static const llvm::CodeGenOpt::Level levels[] = { llvm::CodeGenOpt::None, llvm::CodeGenOpt::Less, llvm::CodeGenOpt::Default, llvm::CodeGenOpt::Aggressive };
+	string error;
+	unique_ptr<llvm::ExecutionEngine> ee(llvm::EngineBuilder(std::move(owned))
+		.setErrorStr(&error)
+		.setEngineKind(llvm::EngineKind::JIT)
+		.setMCJITMemoryManager(unique_ptr<llvm::SectionMemoryManager>(new llvm::SectionMemoryManager()))
+		.setOptLevel(levels[optLevel])
+		.create());
+	if(!ee)
+		throw runtime_error("cannot start the JIT: " + error);
+	if(llvm::Function *f = m->getFunction("print_int"))
+		ee->addGlobalMapping(f, (void *) &print_int);
+	if(llvm::Function *f = m->getFunction("print_string"))
+		ee->addGlobalMapping(f, (void *) &print_string);
+	if(llvm::Function *f = m->getFunction("read_int"))
+		ee->addGlobalMapping(f, (void *) &read_int);
+	ee->finalizeObject();
+
+	uint64_t entry = ee->getFunctionAddress("main");
+	int ret = 0;
+	if(mainFn->getReturnType()->isVoidTy())
+		((void (*)()) entry)();
+	else if(mainFn->getReturnType()->isIntegerTy(1))
+		ret = ((bool (*)()) entry)();
+	else
+		ret = ((int (*)()) entry)();
+	fflush(stdout);
+	return ret;
+}
@@ -0,0 +1,46 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// emit_object - write m to path as a relocatable object for the host,
+// generating code at optLevel. This replaces printing the IR and running
+// llvm-as and llc on it: the object links with gcc and decaf-stdlib.c.
+// The code is position independent, so it links into a PIE too.
+void emit_object(llvm::Module *m, const char *path, unsigned optLevel){
+	// -O0 code may still have dead code after a return or an open block
+	finish_module(m);
+	llvm::InitializeNativeTarget();
+	llvm::InitializeNativeTargetAsmPrinter();
+	string triple = llvm::sys::getDefaultTargetTriple();
+	string error;
+	const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+	if(target == NULL)
+		throw runtime_error("no code generator for " + triple + ": " + error);
+	static const llvm::CodeGenOpt::Level levels[] = { llvm::CodeGenOpt::None, llvm::CodeGenOpt::Less, llvm::CodeGenOpt::Default, llvm::CodeGenOpt::Aggressive };
+	unique_ptr<llvm::TargetMachine> tm(target->createTargetMachine(triple, "generic", "", llvm::TargetOptions(), llvm::Reloc::PIC_, llvm::CodeModel::Default, levels[optLevel]));
+	m->setTargetTriple(triple);
+	m->setDataLayout(tm->createDataLayout());
+
+	std::error_code ec;
+	llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::F_None);
+	if(ec)
+		throw runtime_error(string("cannot write ") + path + ": " + ec.message());
+	llvm::legacy::PassManager pm;
+	if(tm->addPassesToEmitFile(pm, out, llvm::TargetMachine::CGFT_ObjectFile))
+		throw runtime_error("cannot emit an object file for " + triple);
+	pm.run(*m);
+	out.flush();
+	if(out.has_error())
+		throw runtime_error(string("cannot write ") + path);
+}
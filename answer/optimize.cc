@@ -0,0 +1,121 @@
+#include "llvm/Pass.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Support/raw_ostream.h"
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// tidy_blocks - codegen can leave dead code after a return and can leave
+// the block after a loop or an if without a terminator. The passes only
+// take well-formed IR, so drop whatever follows a block's first
+// terminator (and the phi entries its dead branches fed) and close an
+// open block with the return the method would have fallen off the end
+// with: nothing, 0 or true.
+static void tidy_blocks(llvm::Function &f){
+	llvm::LLVMContext &ctx = f.getContext();
+	llvm::Type *rt = f.getReturnType();
+	for(auto &bb : f){
+		for(auto i = bb.begin(); i != bb.end(); ++i){
+			if(!i->isTerminator())
+				continue;
+			while(&bb.back() != &*i){
+				if(llvm::TerminatorInst *t = llvm::dyn_cast<llvm::TerminatorInst>(&bb.back()))
+					for(unsigned s = 0; s < t->getNumSuccessors(); s++)
+						t->getSuccessor(s)->removePredecessor(&bb);
+				bb.back().eraseFromParent();
+			}
+			break;
+		}
+		if(!bb.empty() && bb.back().isTerminator())
+			continue;
+		if(rt->isVoidTy())
+			llvm::ReturnInst::Create(ctx, &bb);
+		else
+			llvm::ReturnInst::Create(ctx, llvm::ConstantInt::get(rt, rt->isIntegerTy(1) ? 1 : 0), &bb);
+	}
+}
+
+// the scalar cleanup every level past -O0 starts with: registers instead
+// of stack slots, then fold and merge what that exposes
+static void add_early_passes(llvm::legacy::PassManager &pm){
+	pm.add(llvm::createPromoteMemoryToRegisterPass());
+	pm.add(llvm::createInstructionCombiningPass());
+	pm.add(llvm::createReassociatePass());
+	pm.add(llvm::createEarlyCSEPass());
+	pm.add(llvm::createCFGSimplificationPass());
+}
+
+// the main function pipeline of -O2 and -O3: propagate, thread the
+// short-circuit and if/end block chains, hoist loop invariants, number
+// values, then clean up the stores and blocks left dead
+static void add_function_passes(llvm::legacy::PassManager &pm, unsigned level){
+	pm.add(llvm::createSROAPass());
+	pm.add(llvm::createEarlyCSEPass());
+	pm.add(llvm::createCorrelatedValuePropagationPass());
+	pm.add(llvm::createJumpThreadingPass());
+	pm.add(llvm::createCFGSimplificationPass());
+	pm.add(llvm::createInstructionCombiningPass());
+	if(level >= 3)
+		pm.add(llvm::createTailCallEliminationPass());
+	pm.add(llvm::createReassociatePass());
+	pm.add(llvm::createLoopRotatePass());
+	pm.add(llvm::createLICMPass());
+	// splits loops on the guards of bounds-check elimination
+	pm.add(llvm::createLoopUnswitchPass());
+	pm.add(llvm::createIndVarSimplifyPass());
+	pm.add(llvm::createLoopDeletionPass());
+	if(level >= 3)
+		pm.add(llvm::createLoopUnrollPass());
+	pm.add(llvm::createGVNPass());
+	pm.add(llvm::createSCCPPass());
+	pm.add(llvm::createInstructionCombiningPass());
+	pm.add(llvm::createJumpThreadingPass());
+	pm.add(llvm::createDeadStoreEliminationPass());
+	pm.add(llvm::createAggressiveDCEPass());
+	pm.add(llvm::createCFGSimplificationPass());
+	pm.add(llvm::createInstructionCombiningPass());
+}
+
+// finish_module - make m well-formed for the passes or a code generator,
+// and check that it is
+void finish_module(llvm::Module *m){
+	for(auto &f : *m)
+		if(!f.isDeclaration())
+			tidy_blocks(f);
+	string problems;
+	llvm::raw_string_ostream os(problems);
+	if(llvm::verifyModule(*m, &os))
+		throw runtime_error("generated code is malformed: " + os.str());
+}
+
+// optimize_module - run the pass pipeline for -O<level> over m. -O0 leaves
+// the module exactly as codegen made it; -O1 promotes locals to registers
+// and folds; -O2 adds interprocedural constant propagation, inlining and
+// the loop and redundancy passes; -O3 inlines more aggressively, promotes
+// arguments, unrolls loops and eliminates tail calls.
+void optimize_module(llvm::Module *m, unsigned level){
+	if(level == 0)
+		return;
+	finish_module(m);
+
+	llvm::legacy::PassManager pm;
+	add_early_passes(pm);
+	if(level >= 2){
+		pm.add(llvm::createIPSCCPPass());
+		pm.add(llvm::createGlobalOptimizerPass());
+		pm.add(llvm::createDeadArgEliminationPass());
+		pm.add(llvm::createInstructionCombiningPass());
+		pm.add(llvm::createCFGSimplificationPass());
+		pm.add(llvm::createFunctionInliningPass(level, 0));
+		if(level >= 3)
+			pm.add(llvm::createArgumentPromotionPass());
+		add_function_passes(pm, level);
+		pm.add(llvm::createGlobalDCEPass());
+		pm.add(llvm::createConstantMergePass());
+	}
+	pm.run(*m);
+}
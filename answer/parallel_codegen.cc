@@ -0,0 +1,186 @@
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Bitcode can only describe blocks that end in exactly one terminator, but
+// this code generator leaves dead code after a return and can leave a block
+// open. seal_blocks makes a shard writable: code after a terminator moves
+// to a block of its own named tail_block, and an open block is closed with
+// an unreachable tagged seal_kind. unseal_blocks undoes both once the shard
+// is back in the main context, so the merged module is what the serial
+// build would have made.
+static const char tail_block[] = "shard.tail";
+static const char seal_kind[] = "decaf.seal";
+
+static void seal_blocks(llvm::Module *m){
+	llvm::LLVMContext &ctx = m->getContext();
+	for(auto &f : *m){
+		for(llvm::Function::iterator bb = f.begin(); bb != f.end(); ++bb){
+			for(auto &inst : *bb){
+				if(inst.isTerminator() && &inst != &bb->back()){
+					llvm::BasicBlock *tail = llvm::BasicBlock::Create(ctx, tail_block, &f, bb->getNextNode());
+					tail->getInstList().splice(tail->end(), bb->getInstList(), ++inst.getIterator(), bb->end());
+					break;
+				}
+			}
+			if(bb->empty() || !bb->back().isTerminator()){
+				llvm::Instruction *u = new llvm::UnreachableInst(ctx, &*bb);
+				u->setMetadata(seal_kind, llvm::MDNode::get(ctx, llvm::None));
+			}
+		}
+	}
+}
+
+static void unseal_blocks(llvm::Function *f){
+	unsigned kind = f->getContext().getMDKindID(seal_kind);
+	for(llvm::Function::iterator bb = f->begin(); bb != f->end(); ){
+		llvm::BasicBlock *b = &*bb++;
+		if(b->back().getMetadata(kind) != NULL)
+			b->back().eraseFromParent();
+		if(b->getName().startswith(tail_block)){
+			llvm::BasicBlock *prev = b->getPrevNode();
+			prev->getInstList().splice(prev->end(), b->getInstList());
+			b->eraseFromParent();
+		}
+	}
+}
+
+// A function's symbol table numbers a name that clashes with one it
+// already holds from a counter that only ever goes up, and the passes of
+// -O1 and up name what they create through it. Reading a shard back gives
+// each function its names but starts the counter over, so clash_names
+// reads the counter in the shard and winds it forward in the merged
+// function: it renames a scratch block onto a taken name times times and
+// returns the number the last clash got.
+static const char clash_name[] = "shard.clash";
+
+static unsigned clash_names(llvm::Function *f, unsigned times){
+	llvm::LLVMContext &ctx = f->getContext();
+	llvm::BasicBlock *taken = llvm::BasicBlock::Create(ctx, clash_name, f);
+	llvm::BasicBlock *scratch = llvm::BasicBlock::Create(ctx, "", f);
+	unsigned n = 0;
+	for(unsigned i = 0; i < times; i++){
+		scratch->setName(clash_name);
+		llvm::StringRef name = scratch->getName();
+		name.substr(name.rtrim("0123456789").size()).getAsInteger(10, n);
+		scratch->setName("");
+	}
+	scratch->eraseFromParent();
+	taken->eraseFromParent();
+	return n;
+}
+
+// move the method bodies of shard, a module read back into the main
+// context, into the declarations proto() made in dest. Everything else in
+// the shard is a declaration of something dest already has or an
+// intrinsic it gets declared, except the string constants; those are
+// appended in order and renamed the way the serial build would have named
+// them. clashes holds the symbol table counter of each method body in the
+// shard, in module order.
+static void merge_shard(llvm::Module *dest, llvm::Module *shard, const vector<unsigned> &clashes){
+	size_t body = 0;
+	vector<llvm::Function *> funcs;
+	for(auto &f : *shard)
+		funcs.push_back(&f);
+	for(auto sf : funcs){
+		llvm::Function *f = dest->getFunction(sf->getName());
+		if(f == NULL){
+			f = llvm::Function::Create(sf->getFunctionType(), sf->getLinkage(), sf->getName(), dest);
+			f->copyAttributesFrom(sf);
+		}
+		if(!sf->isDeclaration()){
+			llvm::Function::arg_iterator a = f->arg_begin();
+			for(auto &sa : sf->args()){
+				a->setName(sa.getName());
+				sa.replaceAllUsesWith(&*a);
+				++a;
+			}
+			unseal_blocks(sf);
+			f->getBasicBlockList().splice(f->end(), sf->getBasicBlockList());
+			clash_names(f, clashes[body++]);
+		}
+		sf->replaceAllUsesWith(f);
+	}
+
+	vector<llvm::GlobalVariable *> globals;
+	for(auto &g : shard->globals())
+		globals.push_back(&g);
+	for(auto sg : globals){
+		if(sg->isDeclaration()){
+			sg->replaceAllUsesWith(dest->getNamedGlobal(sg->getName()));
+			continue;
+		}
+		// drop the ".N" the shard gave it so dest numbers it instead
+		llvm::StringRef name = sg->getName();
+		llvm::StringRef base = name.rtrim("0123456789");
+		base = base.size() < name.size() && base.endswith(".") ? base.drop_back() : name;
+		string stem = base.str();
+		sg->removeFromParent();
+		sg->setName("");
+		dest->getGlobalList().push_back(sg);
+		sg->setName(stem);
+	}
+}
+
+// generate the method bodies in [begin, end) into a module of their own on
+// a fresh LLVMContext and return it as bitcode, with the symbol table
+// counter of each body in clashes
+static string codegen_shard(llvm::ArrayRef<decafAST *> methods, size_t begin, size_t end, bool ssa, bounds_mode bounds, vector<unsigned> &clashes){
+	llvm::LLVMContext context;
+	codegen_context cx(context, "shard");
+	cx.ssa.enabled = ssa;
+	cx.bounds.mode = bounds;
+	for(size_t i = begin; i < end; i++)
+		methods[i]->Codegen(cx);
+	cx.Builder.ClearInsertionPoint();
+	// read the counters before sealing names blocks; reading one takes a
+	// number of its own
+	for(auto &f : *cx.TheModule)
+		if(!f.isDeclaration())
+			clashes.push_back(clash_names(&f, 1) - 1);
+	seal_blocks(cx.TheModule);
+	string bits;
+	llvm::raw_string_ostream os(bits);
+	llvm::WriteBitcodeToFile(cx.TheModule, os);
+	os.flush();
+	return bits;
+}
+
+// codegen_parallel - the same module ProgramAST::Codegen builds into cx,
+// with the method bodies split into contiguous shards generated on pool.
+// Externs, prototypes and fields are generated into cx first, as usual;
+// each shard then gets its own codegen_context, and the shards come back
+// through bitcode and are merged in source order, so the result prints
+// exactly as the serial build does, before the -O passes and after.
+void codegen_parallel(ProgramAST *prog, thread_pool &pool, codegen_context &cx){
+	if(prog->getExterns() != NULL)
+		prog->getExterns()->Codegen(cx);
+	PackageAST *pkg = prog->getPackage();
+	if(pkg == NULL)
+		throw runtime_error("no package definition in decaf program");
+	llvm::ArrayRef<decafAST *> methods = pkg->getMethods()->getList();
+	for(auto m : methods)
+		m->proto(cx);
+	cx.TheModule->setModuleIdentifier(atoms.spelling(pkg->getName()));
+	if(pkg->getFields() != NULL)
+		pkg->getFields()->Codegen(cx);
+
+	// a few shards per thread evens out methods of different sizes
+	size_t shards = min(methods.size(), (size_t) pool.size() * 4);
+	vector<string> bits(shards);
+	vector<vector<unsigned> > clashes(shards);
+	pool.run(shards, [&](size_t i){
+		bits[i] = codegen_shard(methods, methods.size() * i / shards, methods.size() * (i + 1) / shards, cx.ssa.enabled, cx.bounds.mode, clashes[i]);
+	});
+	for(size_t i = 0; i < shards; i++){
+		auto shard = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bits[i], "shard"), cx.getContext());
+		if(!shard)
+			throw runtime_error("cannot read back generated code");
+		merge_shard(cx.TheModule, shard->get(), clashes[i]);
+	}
+}
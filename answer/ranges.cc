@@ -0,0 +1,179 @@
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/Casting.h"
+#include <cstdint>
+
+using namespace std;
+
+// the local int variable e reads, if e is nothing but that
+static TypedSymbolAST *plain_variable(Expr *e){
+	if(e->getKind() != RvalueExprNode)
+		return NULL;
+	Rvalue *r = llvm::cast<Rvalue>(e->getRvalue()->getList()[0]);
+	if(r->getIndex() != NULL)
+		return NULL;
+	TypedSymbolAST *ts = llvm::dyn_cast<TypedSymbolAST>(r->getBinding());
+	return ts != NULL && ts->getType() == IntType ? ts : NULL;
+}
+
+// the step of an assignment var = var + 1, var = 1 + var or var = var - 1:
+// +1, -1, or 0 for anything else
+static int unit_step(Assign *a, TypedSymbolAST *var){
+	if(a->getIndex() != NULL || a->getBinding() != var)
+		return 0;
+	Expr *v = a->getValue();
+	if(v->getKind() != BinaryExprNode)
+		return 0;
+	BinaryOp op = v->getBinaryOp()->getOp();
+	Expr *l = v->getLHS(), *r = v->getRHS();
+	bool one = r->getKind() == IntExprNode && r->getInt() == 1;
+	if(op == Plus && plain_variable(l) == var && one)
+		return 1;
+	if(op == Plus && plain_variable(r) == var && l->getKind() == IntExprNode && l->getInt() == 1)
+		return 1;
+	if(op == Minus && plain_variable(l) == var && one)
+		return -1;
+	return 0;
+}
+
+// loop_scan - what a loop body does that matters to the range of var: the
+// variables and fields it assigns, whether it calls anything, and the
+// smallest array it indexes with var alone
+class loop_scan : public ast_walker<loop_scan>{
+
+public:
+	loop_scan(TypedSymbolAST *v) : var(v), calls(false), size(0) {}
+
+	bool pre(decafAST *n){
+		switch(n->getKind()){
+		case AssignNode: {
+			Assign *a = llvm::cast<Assign>(n);
+			assigned.insert(a->getBinding());
+			if(a->getIndex() != NULL)
+				indexed(a->getBinding(), a->getIndex());
+			return true;
+		}
+		case RvalueNode: {
+			Rvalue *r = llvm::cast<Rvalue>(n);
+			if(r->getIndex() != NULL)
+				indexed(r->getBinding(), r->getIndex());
+			return true;
+		}
+		case MethodCallNode:
+			calls = true;
+			return true;
+		default:
+			return true;
+		}
+	}
+
+	TypedSymbolAST *var;
+	llvm::SmallPtrSet<decafAST *, 8> assigned;
+	bool calls;
+	uint64_t size;
+
+private:
+	void indexed(decafAST *array, Expr *index){
+		if(plain_variable(index) != var || !is_array_field(array))
+			return;
+		uint64_t n = llvm::cast<FieldDeclAST>(array)->getFieldSize()->getSize();
+		if(size == 0 || n < size)
+			size = n;
+	}
+};
+
+// whether n has the same value on every pass through a loop whose body
+// is described by scan: it reads neither the loop's variable nor anything
+// the body assigns, nor fields when the body makes calls
+static bool invariant(decafAST *n, loop_scan &scan){
+	if(Rvalue *r = llvm::dyn_cast<Rvalue>(n)){
+		decafAST *b = r->getBinding();
+		if(b == scan.var || scan.assigned.count(b) || (llvm::isa<FieldDeclAST>(b) && scan.calls))
+			return false;
+	}
+	bool same = true;
+	for_each_child(n, [&](decafAST *c){
+		if(same && !invariant(c, scan))
+			same = false;
+	});
+	return same;
+}
+
+// range_finder - the analysis behind -bounds-check=elide. A for or while
+// loop gets a loop_range when its condition compares a local int variable
+// against a bound that does not change in the loop, the variable moves by
+// one towards the bound once per pass and nowhere else, and the body
+// indexes an array with it. A for loop steps in its update; a while loop
+// steps in the last statement of its body. Codegen turns the range into
+// one guard evaluated before the loop.
+class range_finder : public ast_walker<range_finder>{
+
+public:
+	bool pre(decafAST *n){
+		if(n->getKind() == ForStmtNode || n->getKind() == WhileStmtNode)
+			find(llvm::cast<StatementAST>(n));
+		return true;
+	}
+
+private:
+	void find(StatementAST *s){
+		Expr *cond = s->getCondition();
+		if(cond->getKind() != BinaryExprNode)
+			return;
+		BinaryOp op = cond->getBinaryOp()->getOp();
+		if(op != Lt && op != Leq && op != Gt && op != Geq)
+			return;
+		loop_range range;
+		TypedSymbolAST *var = plain_variable(cond->getLHS());
+		if(var != NULL){
+			range.bound = cond->getRHS();
+		}else if((var = plain_variable(cond->getRHS())) != NULL){
+			// b > i is i < b
+			range.bound = cond->getLHS();
+			op = op == Lt ? Gt : op == Gt ? Lt : op == Leq ? Geq : Leq;
+		}else{
+			return;
+		}
+		range.var = var;
+		range.down = op == Gt || op == Geq;
+		range.inclusive = op == Leq || op == Geq;
+		int step = range.down ? -1 : 1;
+
+		loop_scan scan(var);
+		Block *body = s->getBody();
+		if(s->getKind() == ForStmtNode){
+			llvm::ArrayRef<decafAST *> update = s->getStep()->getList();
+			if(update.size() != 1 || unit_step(llvm::cast<Assign>(update[0]), var) != step)
+				return;
+			for(auto a : s->getInit()->getList()){
+				Assign *init = llvm::cast<Assign>(a);
+				if(init->getBinding() == var && init->getIndex() == NULL)
+					range.start = init->getValue()->getKind() == IntExprNode ? init->getValue() : NULL;
+			}
+			scan.walk(body);
+			if(scan.assigned.count(var))
+				return;
+		}else{
+			decafStmtList *stmts = body->getStmts();
+			if(stmts == NULL || stmts->size() == 0)
+				return;
+			decafAST *last = stmts->getList().back();
+			if(last->getKind() != AssignStmtNode || unit_step(llvm::cast<StatementAST>(last)->getAssign(), var) != step)
+				return;
+			for(auto st : stmts->getList().drop_back())
+				scan.walk(st);
+			if(scan.assigned.count(var))
+				return;
+		}
+		if(scan.size == 0 || !range.bound->pure() || !invariant(range.bound, scan))
+			return;
+		range.size = scan.size;
+		s->setRange(range);
+	}
+};
+
+// find_ranges - record the loop ranges of a resolved, type checked and
+// folded program on its loops
+void find_ranges(ProgramAST *prog){
+	if(prog->getPackage() != NULL)
+		range_finder().walk(prog->getPackage()->getMethods());
+}
@@ -0,0 +1,97 @@
+#include <stdexcept>
+
+using namespace std;
+
+// name_resolver - binds every use of a name to the node that declares it,
+// with the same scoping codegen used to apply: externs and method names in
+// the program scope, fields in the package scope, parameters and the
+// method's own locals in one scope per method, and a scope per nested
+// block. Codegen then reads values straight off the declarations.
+class name_resolver : public ast_walker<name_resolver>{
+
+public:
+	bool pre(decafAST *n){
+		switch(n->getKind()){
+		case ProgramNode:
+			syms.new_symtbl();
+			return true;
+		case PackageNode:
+			// methods can be called before they are defined
+			for(auto m : llvm::cast<PackageAST>(n)->getMethods()->getList())
+				syms.enter_symtbl(llvm::cast<MethodDecl>(m)->getName(), m);
+			syms.new_symtbl();
+			return true;
+		case ExternNode:
+			syms.enter_symtbl(llvm::cast<ExternAST>(n)->getName(), n);
+			return false;
+		case FieldDeclNode:
+			syms.enter_symtbl(llvm::cast<FieldDeclAST>(n)->getName(), n);
+			return false;
+		case TypedSymbolNode:
+			syms.enter_symtbl(llvm::cast<TypedSymbolAST>(n)->getName(), n);
+			return false;
+		case MethodDeclNode:
+		case BlockNode:
+			syms.new_symtbl();
+			return true;
+		case RvalueNode: {
+			Rvalue *r = llvm::cast<Rvalue>(n);
+			descriptor *d = syms.access_symtbl(r->getName());
+			if(d == NULL)
+				throw runtime_error("undeclared variable " + atoms.spelling(r->getName()));
+			if(!is_variable(d->getDecl()))
+				throw runtime_error(atoms.spelling(r->getName()) + " is not a variable");
+			r->setBinding(d->getDecl());
+			return true;
+		}
+		case AssignNode: {
+			Assign *a = llvm::cast<Assign>(n);
+			descriptor *d = syms.access_symtbl(a->getName());
+			if(d == NULL)
+				throw runtime_error("Cannot assign undeclared variable");
+			if(!is_variable(d->getDecl()))
+				throw runtime_error("Cannot assign " + atoms.spelling(a->getName()) + ", it is not a variable");
+			a->setBinding(d->getDecl());
+			return true;
+		}
+		case MethodCallNode: {
+			MethodCallAST *c = llvm::cast<MethodCallAST>(n);
+			descriptor *d = syms.access_symtbl(c->getName());
+			if(d == NULL || !(llvm::isa<ExternAST>(d->getDecl()) || llvm::isa<MethodDecl>(d->getDecl())))
+				throw runtime_error("Method not found in symboltable");
+			c->setBinding(d->getDecl());
+			return true;
+		}
+		default:
+			return true;
+		}
+	}
+
+	void post(decafAST *n){
+		switch(n->getKind()){
+		case ProgramNode:
+		case PackageNode:
+		case MethodDeclNode:
+		case BlockNode:
+			syms.remove_symtbl();
+			return;
+		default:
+			return;
+		}
+	}
+
+private:
+	// a local, parameter or field, as opposed to a method or extern
+	static bool is_variable(decafAST *d){
+		return llvm::isa<TypedSymbolAST>(d) || llvm::isa<FieldDeclAST>(d);
+	}
+
+	symboltable syms;
+};
+
+// resolve_names - bind the names in prog; throws on the first name that
+// has no declaration in scope, or that a variable use binds to a method or
+// extern
+void resolve_names(ProgramAST *prog){
+	name_resolver().walk(prog);
+}
@@ -0,0 +1,196 @@
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// the declared type of a variable, parameter or field; the resolver binds
+// nothing else to an Rvalue or Assign
+DecafType var_type(decafAST *d){
+	if(TypedSymbolAST *ts = llvm::dyn_cast<TypedSymbolAST>(d))
+		return ts->getType();
+	return llvm::cast<FieldDeclAST>(d)->getType()->getType();
+}
+
+// the return type of an extern or method
+DecafType call_type(decafAST *d){
+	if(ExternAST *e = llvm::dyn_cast<ExternAST>(d))
+		return e->getReturnType()->getType();
+	return llvm::cast<MethodDecl>(d)->getReturnType()->getType();
+}
+
+// whether d is an array field rather than a scalar variable
+static bool is_array_field(decafAST *d){
+	FieldDeclAST *f = llvm::dyn_cast<FieldDeclAST>(d);
+	// an initialised field has no FieldSize, a plain one a scalar FieldSize
+	return f != NULL && f->getFieldSize() != NULL && !f->getFieldSize()->isScalar();
+}
+
+// type_checker - annotates every Rvalue, MethodCallAST and Expr below the
+// nodes it walks with its Decaf type, children before parents, and reports
+// what does not type check. Touches nothing outside the subtree it walks,
+// so checkers for different methods can run at the same time.
+class type_checker : public ast_walker<type_checker>{
+
+public:
+	type_checker(vector<string> &d) : diags(d), method(NULL) {}
+
+	bool pre(decafAST *n){
+		if(n->getKind() == MethodDeclNode)
+			method = llvm::cast<MethodDecl>(n);
+		return true;
+	}
+
+	void post(decafAST *n){
+		switch(n->getKind()){
+		case RvalueNode: {
+			Rvalue *r = llvm::cast<Rvalue>(n);
+			r->setType(var_type(r->getBinding()));
+			check_index(r->getName(), r->getBinding(), r->getIndex());
+			return;
+		}
+		case MethodCallNode: {
+			MethodCallAST *c = llvm::cast<MethodCallAST>(n);
+			c->setType(call_type(c->getBinding()));
+			check_args(c);
+			return;
+		}
+		case RvalueExprNode: {
+			Expr *e = llvm::cast<Expr>(n);
+			e->setType(llvm::cast<Rvalue>(e->getRvalue()->getList()[0])->getType());
+			return;
+		}
+		case CallExprNode: {
+			Expr *e = llvm::cast<Expr>(n);
+			e->setType(e->getCall()->getType());
+			return;
+		}
+		case IntExprNode:
+			llvm::cast<Expr>(n)->setType(IntType);
+			return;
+		case BoolExprNode:
+			llvm::cast<Expr>(n)->setType(BoolType);
+			return;
+		case BinaryExprNode: {
+			Expr *e = llvm::cast<Expr>(n);
+			BinaryOp op = e->getBinaryOp()->getOp();
+			e->setType(binops[op].compare || op == And || op == Or ? BoolType : IntType);
+			check_operands(op, e->getLHS()->getType(), e->getRHS()->getType());
+			return;
+		}
+		case UnaryExprNode: {
+			Expr *e = llvm::cast<Expr>(n);
+			UnaryOp op = e->getUnaryOp()->getOp();
+			DecafType t = op == Not ? BoolType : IntType;
+			e->setType(t);
+			if(e->getOperand()->getType() != t)
+				diags.push_back(string("operand of ") + unop_names[op] + " is not " + (t == BoolType ? "a bool" : "an int"));
+			return;
+		}
+		case AssignNode: {
+			Assign *a = llvm::cast<Assign>(n);
+			check_index(a->getName(), a->getBinding(), a->getIndex());
+			if(a->getValue()->getType() != var_type(a->getBinding()))
+				diags.push_back("mismatched type for variable " + atoms.spelling(a->getName()));
+			return;
+		}
+		case IfStmtNode:
+		case WhileStmtNode:
+		case ForStmtNode:
+			if(llvm::cast<StatementAST>(n)->getCondition()->getType() != BoolType)
+				diags.push_back(string(n->getKind() == IfStmtNode ? "if" : n->getKind() == WhileStmtNode ? "while" : "for") + " condition is not a bool");
+			return;
+		case ReturnStmtNode: {
+			DecafType t = method->getReturnType()->getType();
+			if(t == VoidType)
+				diags.push_back("void method " + atoms.spelling(method->getName()) + " returns a value");
+			else if(llvm::cast<StatementAST>(n)->getValue()->getType() != t)
+				diags.push_back("mismatched return type in method " + atoms.spelling(method->getName()));
+			return;
+		}
+		default:
+			return;
+		}
+	}
+
+private:
+	// an array has to be indexed, with an int, and a scalar must not be
+	void check_index(atom name, decafAST *binding, Expr *index){
+		if(index == NULL){
+			if(is_array_field(binding))
+				diags.push_back("array " + atoms.spelling(name) + " used without an index");
+		}else if(!is_array_field(binding)){
+			diags.push_back(atoms.spelling(name) + " is not an array");
+		}else if(index->getType() != IntType){
+			diags.push_back("index of array " + atoms.spelling(name) + " is not an int");
+		}
+	}
+
+	// == and != compare operands of one type, && and || take bools and
+	// everything else ints
+	void check_operands(BinaryOp op, DecafType l, DecafType r){
+		if(op == Eq || op == Neq){
+			if(l != r)
+				diags.push_back(string("operands of ") + binops[op].name + " have different types");
+			return;
+		}
+		DecafType t = op == And || op == Or ? BoolType : IntType;
+		if(l != t || r != t)
+			diags.push_back(string("operands of ") + binops[op].name + " are not " + (t == BoolType ? "bools" : "ints"));
+	}
+
+	// the arguments of c against the parameters of the extern or method it
+	// calls: as many, and each of the declared type or promotable to it
+	void check_args(MethodCallAST *c){
+		vector<DecafType> params;
+		if(ExternAST *e = llvm::dyn_cast<ExternAST>(c->getBinding())){
+			for(auto t : e->getTypes()->getList())
+				params.push_back(llvm::cast<ExternTypeAST>(t)->getType());
+		}else{
+			for(auto p : llvm::cast<MethodDecl>(c->getBinding())->getParams()->getList())
+				params.push_back(llvm::cast<TypedSymbolAST>(p)->getType());
+		}
+		llvm::ArrayRef<decafAST *> args = c->getArgs()->getList();
+		if(args.size() != params.size()){
+			diags.push_back("wrong number of arguments in call to " + atoms.spelling(c->getName()));
+			return;
+		}
+		for(size_t i = 0; i < args.size(); i++){
+			Expr *e = llvm::cast<MethodArg>(args[i])->getExpr();
+			DecafType t = e != NULL ? e->getType() : StringType;
+			// codegen promotes a bool argument to an int parameter
+			if(t != params[i] && !(t == BoolType && params[i] == IntType))
+				diags.push_back("mismatched type for argument " + to_string(i + 1) + " in call to " + atoms.spelling(c->getName()));
+		}
+	}
+
+	vector<string> &diags;
+	// the method being checked
+	MethodDecl *method;
+};
+
+// check_methods - type check a resolved program: the field initialisers
+// first, then every method body as its own job on pool. The diagnostics
+// come back in source order whatever order the jobs finished in.
+vector<string> check_methods(ProgramAST *prog, thread_pool &pool){
+	if(prog->getPackage() == NULL)
+		return vector<string>();
+	vector<string> diags;
+	type_checker(diags).walk(prog->getPackage()->getFields());
+	llvm::ArrayRef<decafAST *> methods = prog->getPackage()->getMethods()->getList();
+	vector<vector<string> > found(methods.size());
+	pool.run(methods.size(), [&](size_t i){
+		type_checker(found[i]).walk(methods[i]);
+	});
+	for(auto &d : found)
+		diags.insert(diags.end(), d.begin(), d.end());
+	return diags;
+}
+
+// check_program - check a resolved program and print its diagnostics;
+// returns whether it passed
+bool check_program(ProgramAST *prog, thread_pool &pool){
+	vector<string> diags = check_methods(prog, pool);
+	for(auto &d : diags)
+		cout << "semantic error: " << d << endl;
+	return diags.empty();
+}
@@ -0,0 +1,65 @@
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// source_file - a Decaf program mapped straight from disk. The mapping is
+// followed by two zero bytes so flex can scan it in place with
+// yy_scan_buffer. It is private copy-on-write because flex briefly writes
+// a NUL after each token; nothing is ever written back to the file.
+class source_file{
+
+public:
+	source_file() : base(NULL), len(0), mapped(0) {}
+	~source_file(){ close(); }
+
+	void open(const char *path){
+		int fd = ::open(path, O_RDONLY);
+		if(fd < 0)
+			throw runtime_error(string("cannot open ") + path);
+		struct stat st;
+		if(fstat(fd, &st) < 0){
+			::close(fd);
+			throw runtime_error(string("cannot stat ") + path);
+		}
+		len = st.st_size;
+
+		// reserve room for the file plus the two sentinel bytes, then lay the
+		// file over the front of it; anything past the end reads as zero
+		long page = sysconf(_SC_PAGESIZE);
+		mapped = (len + 2 + page - 1) / page * page;
+		void *p = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(p == MAP_FAILED){
+			::close(fd);
+			throw runtime_error(string("cannot map ") + path);
+		}
+		if(len > 0 && mmap(p, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED){
+			munmap(p, mapped);
+			::close(fd);
+			throw runtime_error(string("cannot map ") + path);
+		}
+		::close(fd);
+		madvise(p, mapped, MADV_SEQUENTIAL);
+		base = (char *) p;
+	}
+
+	void close(){
+		if(base != NULL)
+			munmap(base, mapped);
+		base = NULL;
+		len = mapped = 0;
+	}
+
+	// the source text; data()[size()] and data()[size()+1] are both zero
+	char *data(){ return base; }
+	size_t size(){ return len; }
+
+private:
+	char *base;
+	size_t len;
+	size_t mapped;
+};
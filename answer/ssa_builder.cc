@@ -0,0 +1,137 @@
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/ValueHandle.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+class decafAST;
+
+// ssa_builder - SSA form for a method's locals and parameters, built while
+// the method is generated (Braun et al., "Simple and Efficient Construction
+// of Static Single Assignment Form"). An assignment records its value as
+// the variable's definition in the current block; a use looks for one in
+// its block, then asks the predecessors, placing a phi where several paths
+// meet. A block is sealed once every branch into it exists. Until then a
+// use there gets an operandless phi, which seal() fills in. Phis that
+// merge a single value are folded away as soon as they are complete, so
+// the method comes out in register form with no mem2reg pass.
+class ssa_builder{
+
+public:
+	ssa_builder() : enabled(false) {}
+
+	// start a new method
+	void clear(){
+		vars.clear();
+		defs.clear();
+		incomplete.clear();
+		sealed.clear();
+	}
+
+	// a local or parameter of type ty; name is given to its phis
+	void declare(decafAST *var, llvm::Type *ty, const string &name){
+		vars[var] = make_pair(ty, name);
+	}
+
+	void define(decafAST *var, llvm::BasicBlock *bb, llvm::Value *v){
+		defs[make_pair(var, bb)] = v;
+	}
+
+	llvm::Value *use(decafAST *var, llvm::BasicBlock *bb){
+		auto i = defs.find(make_pair(var, bb));
+		if(i != defs.end() && i->second != NULL)
+			return i->second;
+		return use_from_predecessors(var, bb);
+	}
+
+	void seal(llvm::BasicBlock *bb){
+		if(!enabled)
+			return;
+		auto i = incomplete.find(bb);
+		if(i != incomplete.end()){
+			vector<pair<decafAST *, llvm::PHINode *> > phis;
+			phis.swap(i->second);
+			incomplete.erase(i);
+			for(auto &p : phis)
+				add_operands(p.first, p.second);
+		}
+		sealed.insert(bb);
+	}
+
+	// whether locals and parameters go through here instead of stack slots
+	bool enabled;
+
+private:
+	llvm::Value *use_from_predecessors(decafAST *var, llvm::BasicBlock *bb){
+		llvm::Value *v;
+		if(!sealed.count(bb)){
+			llvm::PHINode *phi = new_phi(var, bb);
+			incomplete[bb].push_back(make_pair(var, phi));
+			v = phi;
+		}else if(llvm::BasicBlock *pred = bb->getSinglePredecessor()){
+			v = use(var, pred);
+		}else if(llvm::pred_begin(bb) == llvm::pred_end(bb)){
+			// read before any assignment
+			v = llvm::UndefValue::get(vars[var].first);
+		}else{
+			// define the phi first so a loop back to bb finds it
+			llvm::PHINode *phi = new_phi(var, bb);
+			define(var, bb, phi);
+			v = add_operands(var, phi);
+		}
+		define(var, bb, v);
+		return v;
+	}
+
+	llvm::PHINode *new_phi(decafAST *var, llvm::BasicBlock *bb){
+		llvm::PHINode *phi = llvm::PHINode::Create(vars[var].first, 0, vars[var].second);
+		bb->getInstList().push_front(phi);
+		return phi;
+	}
+
+	llvm::Value *add_operands(decafAST *var, llvm::PHINode *phi){
+		llvm::BasicBlock *bb = phi->getParent();
+		for(llvm::pred_iterator p = llvm::pred_begin(bb), e = llvm::pred_end(bb); p != e; ++p)
+			phi->addIncoming(use(var, *p), *p);
+		return fold_trivial(phi);
+	}
+
+	// replace a phi whose operands are all one value (or itself) by that
+	// value, then retry the phis that used it
+	llvm::Value *fold_trivial(llvm::PHINode *phi){
+		llvm::Value *same = NULL;
+		for(unsigned i = 0; i < phi->getNumIncomingValues(); i++){
+			llvm::Value *op = phi->getIncomingValue(i);
+			if(op == same || op == phi)
+				continue;
+			if(same != NULL)
+				return phi;
+			same = op;
+		}
+		if(same == NULL)
+			same = llvm::UndefValue::get(phi->getType());
+		vector<llvm::WeakVH> users;
+		for(auto u : phi->users())
+			if(u != phi && llvm::isa<llvm::PHINode>(u))
+				users.push_back(u);
+		// defs hold WeakVHs, so they follow the phi to same
+		phi->replaceAllUsesWith(same);
+		phi->eraseFromParent();
+		for(auto &u : users)
+			if(llvm::PHINode *p = llvm::dyn_cast_or_null<llvm::PHINode>((llvm::Value *) u))
+				fold_trivial(p);
+		return same;
+	}
+
+	llvm::DenseMap<decafAST *, pair<llvm::Type *, string> > vars;
+	// the value of each variable at the end of each block visited so far
+	llvm::DenseMap<pair<decafAST *, llvm::BasicBlock *>, llvm::WeakVH> defs;
+	llvm::DenseMap<llvm::BasicBlock *, vector<pair<decafAST *, llvm::PHINode *> > > incomplete;
+	llvm::SmallPtrSet<llvm::BasicBlock *, 16> sealed;
+};
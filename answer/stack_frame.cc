@@ -0,0 +1,85 @@
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// stack_frame - the stack slots of the method being generated. Every slot
+// is allocated in the entry block, so a local declared in a loop body
+// gets one fixed slot instead of a fresh alloca on each iteration. The
+// locals of a nested block are live from the block's start to its end,
+// marked with llvm.lifetime.start/end. When the block closes, its slots
+// go back to a free list for their type, and a later block reuses them.
+// Blocks with disjoint scopes therefore share slots, and the frame is as
+// large as the deepest nesting of declarations.
+class stack_frame {
+public:
+	stack_frame() : entry(NULL), last(NULL) {}
+
+	// start a new method whose entry block is bb
+	void begin(llvm::BasicBlock *bb){
+		entry = bb;
+		last = NULL;
+		free.clear();
+		scopes.clear();
+	}
+
+	// enter and leave a nested block; the method's own locals and its
+	// parameters are outside every scope and live for the whole call
+	void open_scope(){
+		scopes.push_back(vector<llvm::AllocaInst *>());
+	}
+	void close_scope(llvm::IRBuilder<> &b){
+		vector<llvm::AllocaInst *> slots;
+		slots.swap(scopes.back());
+		scopes.pop_back();
+		// code after a return is dead and has nowhere to put the marker
+		bool live = b.GetInsertBlock()->getTerminator() == NULL;
+		for(auto i = slots.rbegin(); i != slots.rend(); ++i){
+			if(live)
+				b.CreateLifetimeEnd(*i, size(*i));
+			free[(*i)->getAllocatedType()].push_back(*i);
+		}
+	}
+
+	// a slot of type ty for a local declared at b's insertion point
+	llvm::AllocaInst *allocate(llvm::Type *ty, const string &name, llvm::IRBuilder<> &b){
+		llvm::AllocaInst *slot;
+		vector<llvm::AllocaInst *> &reusable = free[ty];
+		if(!reusable.empty()){
+			slot = reusable.back();
+			reusable.pop_back();
+		}else{
+			// keep the allocas together, in declaration order, at the top
+			// of the entry block
+			llvm::IRBuilder<> at(entry, last == NULL ? entry->begin() : std::next(last->getIterator()));
+			slot = at.CreateAlloca(ty, nullptr, name);
+			last = slot;
+		}
+		if(!scopes.empty()){
+			b.CreateLifetimeStart(slot, size(slot));
+			scopes.back().push_back(slot);
+		}
+		return slot;
+	}
+
+private:
+	llvm::ConstantInt *size(llvm::AllocaInst *slot){
+		const llvm::DataLayout &dl = entry->getModule()->getDataLayout();
+		return llvm::ConstantInt::get(llvm::Type::getInt64Ty(slot->getContext()), dl.getTypeAllocSize(slot->getAllocatedType()));
+	}
+
+	llvm::BasicBlock *entry;
+	// the last alloca placed in the entry block
+	llvm::AllocaInst *last;
+	// slots of closed scopes, by type
+	llvm::DenseMap<llvm::Type *, vector<llvm::AllocaInst *> > free;
+	// the slots of each open nested block, innermost last
+	vector<vector<llvm::AllocaInst *> > scopes;
+};
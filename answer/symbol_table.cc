@@ -1,72 +1,127 @@
-#include <string>
-#include <map>
-#include <list>
-#include <fstream>
-#include <sstream>
-#include <cstdlib>
+#include <vector>
 #include <stdexcept>
-#include <iterator>
-#include <algorithm>
 #include <iostream>
 
 using namespace std;
 
+// symboltable - every binding of every open scope in one flat table. An
+// open-addressing hash maps each name to its innermost binding, and each
+// binding links to the one it shadows, so a lookup costs one probe however
+// deeply scopes nest. Bindings are pushed onto a pooled stack that doubles
+// as the undo log: leaving a scope pops back to where it started and
+// re-exposes whatever each popped binding shadowed. Once the pool and the
+// hash have grown to fit a program, scopes come and go without allocating.
 class symboltable{
 
 public:
-	symboltable(){}
-
-	void new_symtbl(){
-		symbol_table *new_symtbl = new symbol_table();
-		symtbl.push_front(new_symtbl);
+	symboltable() : slots(initial_slots), used(0), top(0) {}
+	~symboltable(){
+		for(auto c : chunks)
+			delete[] c;
 	}
 
-	void pop_symtbl(){
-		if(symtbl.empty())
-			throw runtime_error("no symbol table to remove");
-		symtbl.pop_front();
+	void new_symtbl(){
+		scopes.push_back(top);
 	}
 
 	void remove_symtbl(){
-		symbol_table *tbl;
-		if(symtbl.empty())
+		if(scopes.empty())
 			throw runtime_error("no symbol table to remove");
-		else{
-			tbl = symtbl.front();
-			tbl -> clear();
-			delete(tbl);
+		int mark = scopes.back();
+		scopes.pop_back();
+		while(top > mark){
+			binding &b = at(--top);
+			find_slot(b.name)->head = b.shadowed;
 		}
-		symtbl.pop_front();
 	}
 
-	void enter_symtbl(string ident, descriptor *d){
-		symbol_table *tbl;
-		symbol_table::iterator find_ident;
+	// drop every scope, e.g. after a pass was abandoned part way through
+	void clear(){
+		while(!scopes.empty())
+			remove_symtbl();
+	}
 
-		if(symtbl.empty())
-		{
+	descriptor *enter_symtbl(atom ident, decafAST *decl){
+		if(scopes.empty())
 			throw runtime_error("no symbol table created");
+		slot *s = find_slot(ident);
+		if(s->name != ident){
+			s->name = ident;
+			s->head = -1;
+			if(++used * 2 > slots.size()){
+				grow();
+				s = find_slot(ident);
+			}
 		}
-		tbl = symtbl.front();
-		if((find_ident = tbl -> find(ident)) != tbl -> end()){
-			cerr << "Warning: redefining previously defined identifier: " << ident << endl;
-			delete(find_ident -> second);
-			tbl -> erase(ident);
+		if(s->head >= scopes.back()){
+			cerr << "Warning: redefining previously defined identifier: " << atoms.spelling(ident) << endl;
+			at(s->head).d = descriptor(decl);
+			return &at(s->head).d;
 		}
-		(*tbl)[ident] = d;
+		if(top == (int) chunks.size() * chunk_size)
+			chunks.push_back(new binding[chunk_size]);
+		binding &b = at(top);
+		b.name = ident;
+		b.shadowed = s->head;
+		b.d = descriptor(decl);
+		s->head = top++;
+		return &b.d;
 	}
 
-	descriptor* access_symtbl(string ident){
-		for(symbol_table_list::iterator i = symtbl.begin(); i != symtbl.end(); ++i){
-			symbol_table::iterator find_ident;
-			if((find_ident = (*i) -> find(ident)) != (*i) -> end())
-				return find_ident -> second;
-		}
-		return NULL;
+	descriptor* access_symtbl(atom ident){
+		slot *s = find_slot(ident);
+		if(s->name != ident || s->head < 0)
+			return NULL;
+		return &at(s->head).d;
 	}
 
 private:
-	typedef map<string, descriptor* > symbol_table;
-	typedef list<symbol_table* > symbol_table_list;
-	symbol_table_list symtbl;
-};
\ No newline at end of file
+	static const size_t initial_slots = 256;
+	static const int chunk_bits = 8;
+	static const int chunk_size = 1 << chunk_bits;
+
+	// a name that has been bound at some point; head is its innermost live
+	// binding, or -1 while it has none
+	struct slot {
+		atom name;
+		int head;
+		slot() : name(-1), head(-1) {}
+	};
+
+	struct binding {
+		atom name;
+		int shadowed;
+		descriptor d;
+	};
+
+	binding &at(int i){
+		return chunks[i >> chunk_bits][i & (chunk_size - 1)];
+	}
+
+	// the slot holding name, or the empty slot where it would go
+	slot *find_slot(atom name){
+		size_t mask = slots.size() - 1;
+		for(size_t i = ((unsigned int) name * 2654435761u) & mask; ; i = (i + 1) & mask){
+			if(slots[i].name == name || slots[i].name == -1)
+				return &slots[i];
+		}
+	}
+
+	void grow(){
+		vector<slot> old(slots.size() * 2);
+		old.swap(slots);
+		for(auto &s : old)
+			if(s.name != -1)
+				*find_slot(s.name) = s;
+	}
+
+	symboltable(const symboltable &);
+	symboltable &operator=(const symboltable &);
+
+	vector<slot> slots;
+	size_t used;
+	vector<binding *> chunks;
+	int top;
+	// the value of top when each open scope was entered
+	vector<int> scopes;
+};
@@ -0,0 +1,113 @@
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// thread_pool - a fixed set of worker threads for batches of independent
+// jobs. run(n, f) calls f(i) once for each i in [0, n), spread over the
+// workers and the calling thread, and returns once all of them are done.
+// If jobs throw, the exception of the lowest-numbered one is rethrown, so
+// failures come out the same however the jobs were scheduled.
+class thread_pool{
+
+public:
+	// jobs = 0 picks one thread per core; jobs = 1 runs everything inline
+	thread_pool(unsigned jobs = 0) : job(NULL), total(0), pending(0), generation(0), stopping(false) {
+		if(jobs == 0)
+			jobs = max(1u, thread::hardware_concurrency());
+		for(unsigned i = 1; i < jobs; i++)
+			workers.push_back(thread([this]{ worker(); }));
+	}
+	~thread_pool(){
+		{
+			lock_guard<mutex> l(m);
+			stopping = true;
+		}
+		wake.notify_all();
+		for(auto &t : workers)
+			t.join();
+	}
+
+	unsigned size() const { return workers.size() + 1; }
+
+	template <class F>
+	void run(size_t n, F f){
+		if(workers.empty() || n <= 1){
+			for(size_t i = 0; i < n; i++)
+				f(i);
+			return;
+		}
+		function<void(size_t)> fn(f);
+		unique_lock<mutex> l(m);
+		job = &fn;
+		total = n;
+		next = 0;
+		failed_index = n;
+		failure = exception_ptr();
+		pending = workers.size();
+		generation++;
+		l.unlock();
+		wake.notify_all();
+		work();
+		l.lock();
+		done.wait(l, [this]{ return pending == 0; });
+		job = NULL;
+		if(failure)
+			rethrow_exception(failure);
+	}
+
+private:
+	void work(){
+		for(size_t i; (i = next.fetch_add(1)) < total; ){
+			try {
+				(*job)(i);
+			}
+			catch (...) {
+				lock_guard<mutex> l(m);
+				if(i < failed_index){
+					failed_index = i;
+					failure = current_exception();
+				}
+			}
+		}
+	}
+
+	void worker(){
+		unsigned long seen = 0;
+		unique_lock<mutex> l(m);
+		for(;;){
+			wake.wait(l, [&]{ return stopping || generation != seen; });
+			if(stopping)
+				return;
+			seen = generation;
+			l.unlock();
+			work();
+			l.lock();
+			if(--pending == 0)
+				done.notify_one();
+		}
+	}
+
+	thread_pool(const thread_pool &);
+	thread_pool &operator=(const thread_pool &);
+
+	vector<thread> workers;
+	mutex m;
+	condition_variable wake;
+	condition_variable done;
+	// the batch being run; workers pick indexes off next until it passes total
+	function<void(size_t)> *job;
+	size_t total;
+	atomic<size_t> next;
+	size_t failed_index;
+	exception_ptr failure;
+	// workers still busy with the current batch
+	size_t pending;
+	unsigned long generation;
+	bool stopping;
+};
@@ -0,0 +1,246 @@
+#include "llvm/Support/Casting.h"
+
+using namespace std;
+
+// for_each_child - call f on each child of n that is present, in the order
+// the printer visits them. Dispatch is a switch on the node kind, so a walk
+// makes no virtual calls.
+template <class F>
+void for_each_child(decafAST *n, F f){
+	auto g = [&f](decafAST *c){ if(c != NULL) f(c); };
+	switch(n->getKind()){
+	case StmtListNode:
+		for(auto c : llvm::cast<decafStmtList>(n)->getList())
+			g(c);
+		return;
+	case PackageNode: {
+		PackageAST *p = llvm::cast<PackageAST>(n);
+		g(p->getFields());
+		g(p->getMethods());
+		return;
+	}
+	case ProgramNode: {
+		ProgramAST *p = llvm::cast<ProgramAST>(n);
+		g(p->getExterns());
+		g(p->getPackage());
+		return;
+	}
+	case TypedSymbolNode:
+		g(llvm::cast<TypedSymbolAST>(n)->getTypeNode());
+		return;
+	case ExternNode: {
+		ExternAST *e = llvm::cast<ExternAST>(n);
+		g(e->getReturnType());
+		g(e->getTypes());
+		return;
+	}
+	case MethodCallNode:
+		g(llvm::cast<MethodCallAST>(n)->getArgs());
+		return;
+	case RvalueExprNode:
+		g(llvm::cast<Expr>(n)->getRvalue());
+		return;
+	case CallExprNode:
+		g(llvm::cast<Expr>(n)->getCall());
+		return;
+	case BinaryExprNode: {
+		Expr *e = llvm::cast<Expr>(n);
+		g(e->getBinaryOp());
+		g(e->getLHS());
+		g(e->getRHS());
+		return;
+	}
+	case UnaryExprNode: {
+		Expr *e = llvm::cast<Expr>(n);
+		g(e->getUnaryOp());
+		g(e->getOperand());
+		return;
+	}
+	case FieldSizeNode: {
+		FieldSize *fs = llvm::cast<FieldSize>(n);
+		g(fs->getType());
+		return;
+	}
+	case FieldDeclNode: {
+		FieldDeclAST *fd = llvm::cast<FieldDeclAST>(n);
+		g(fd->getType());
+		g(fd->getFieldSize());
+		g(fd->getValue());
+		return;
+	}
+	case MethodArgNode: {
+		MethodArg *a = llvm::cast<MethodArg>(n);
+		g(a->getExpr());
+		return;
+	}
+	case MethodBlockNode: {
+		MethodBlock *b = llvm::cast<MethodBlock>(n);
+		g(b->getVars());
+		g(b->getStmts());
+		return;
+	}
+	case MethodDeclNode: {
+		MethodDecl *m = llvm::cast<MethodDecl>(n);
+		g(m->getReturnType());
+		g(m->getParams());
+		g(m->getBlock());
+		return;
+	}
+	case RvalueNode: {
+		Rvalue *r = llvm::cast<Rvalue>(n);
+		g(r->getIndex());
+		return;
+	}
+	case AssignNode: {
+		Assign *a = llvm::cast<Assign>(n);
+		g(a->getIndex());
+		g(a->getValue());
+		return;
+	}
+	case BlockNode: {
+		Block *b = llvm::cast<Block>(n);
+		g(b->getVars());
+		g(b->getStmts());
+		return;
+	}
+	case AssignStmtNode:
+		g(llvm::cast<StatementAST>(n)->getAssign());
+		return;
+	case CallStmtNode:
+		g(llvm::cast<StatementAST>(n)->getCall());
+		return;
+	case IfStmtNode: {
+		StatementAST *s = llvm::cast<StatementAST>(n);
+		g(s->getCondition());
+		g(s->getThen());
+		g(s->getElse());
+		return;
+	}
+	case WhileStmtNode: {
+		StatementAST *s = llvm::cast<StatementAST>(n);
+		g(s->getCondition());
+		g(s->getBody());
+		return;
+	}
+	case ForStmtNode: {
+		StatementAST *s = llvm::cast<StatementAST>(n);
+		g(s->getInit());
+		g(s->getCondition());
+		g(s->getStep());
+		g(s->getBody());
+		return;
+	}
+	case ReturnStmtNode:
+		g(llvm::cast<StatementAST>(n)->getValue());
+		return;
+	case VoidReturnStmtNode:
+		g(llvm::cast<StatementAST>(n)->getVoidValue());
+		return;
+	case BlockStmtNode:
+		g(llvm::cast<StatementAST>(n)->getBlock());
+		return;
+	default:
+		// types, operators, break and continue have no children
+		return;
+	}
+}
+
+// ast_visitor - dispatch on the node kind to Derived::visitX for the class of
+// the node. Every visitX defaults to visitNode, so a pass only overrides the
+// classes it cares about. Expr and StatementAST forms each come to a single
+// visitExpr/visitStatement, which can switch on getKind() in turn.
+template <class Derived, class Ret = void>
+class ast_visitor{
+
+public:
+	Ret visit(decafAST *n){
+		switch(n->getKind()){
+		case StmtListNode: return self().visitStmtList(llvm::cast<decafStmtList>(n));
+		case PackageNode: return self().visitPackage(llvm::cast<PackageAST>(n));
+		case ProgramNode: return self().visitProgram(llvm::cast<ProgramAST>(n));
+		case DecafTypeNode: return self().visitDecafType(llvm::cast<DecafTypeAST>(n));
+		case MethodTypeNode: return self().visitMethodType(llvm::cast<MethodTypeAST>(n));
+		case ExternTypeNode: return self().visitExternType(llvm::cast<ExternTypeAST>(n));
+		case TypedSymbolNode: return self().visitTypedSymbol(llvm::cast<TypedSymbolAST>(n));
+		case ExternNode: return self().visitExtern(llvm::cast<ExternAST>(n));
+		case BinaryOperatorNode: return self().visitBinaryOperator(llvm::cast<BinaryOperator>(n));
+		case UnaryOperatorNode: return self().visitUnaryOperator(llvm::cast<UnaryOperator>(n));
+		case MethodCallNode: return self().visitMethodCall(llvm::cast<MethodCallAST>(n));
+		case FieldSizeNode: return self().visitFieldSize(llvm::cast<FieldSize>(n));
+		case FieldDeclNode: return self().visitFieldDecl(llvm::cast<FieldDeclAST>(n));
+		case MethodArgNode: return self().visitMethodArg(llvm::cast<MethodArg>(n));
+		case MethodBlockNode: return self().visitMethodBlock(llvm::cast<MethodBlock>(n));
+		case MethodDeclNode: return self().visitMethodDecl(llvm::cast<MethodDecl>(n));
+		case RvalueNode: return self().visitRvalue(llvm::cast<Rvalue>(n));
+		case AssignNode: return self().visitAssign(llvm::cast<Assign>(n));
+		case BlockNode: return self().visitBlock(llvm::cast<Block>(n));
+		default:
+			if(llvm::isa<Expr>(n))
+				return self().visitExpr(llvm::cast<Expr>(n));
+			return self().visitStatement(llvm::cast<StatementAST>(n));
+		}
+	}
+
+	Ret visitNode(decafAST *n){ return Ret(); }
+	Ret visitStmtList(decafStmtList *n){ return self().visitNode(n); }
+	Ret visitPackage(PackageAST *n){ return self().visitNode(n); }
+	Ret visitProgram(ProgramAST *n){ return self().visitNode(n); }
+	Ret visitDecafType(DecafTypeAST *n){ return self().visitNode(n); }
+	Ret visitMethodType(MethodTypeAST *n){ return self().visitNode(n); }
+	Ret visitExternType(ExternTypeAST *n){ return self().visitNode(n); }
+	Ret visitTypedSymbol(TypedSymbolAST *n){ return self().visitNode(n); }
+	Ret visitExtern(ExternAST *n){ return self().visitNode(n); }
+	Ret visitBinaryOperator(BinaryOperator *n){ return self().visitNode(n); }
+	Ret visitUnaryOperator(UnaryOperator *n){ return self().visitNode(n); }
+	Ret visitMethodCall(MethodCallAST *n){ return self().visitNode(n); }
+	Ret visitExpr(Expr *n){ return self().visitNode(n); }
+	Ret visitFieldSize(FieldSize *n){ return self().visitNode(n); }
+	Ret visitFieldDecl(FieldDeclAST *n){ return self().visitNode(n); }
+	Ret visitMethodArg(MethodArg *n){ return self().visitNode(n); }
+	Ret visitMethodBlock(MethodBlock *n){ return self().visitNode(n); }
+	Ret visitMethodDecl(MethodDecl *n){ return self().visitNode(n); }
+	Ret visitRvalue(Rvalue *n){ return self().visitNode(n); }
+	Ret visitAssign(Assign *n){ return self().visitNode(n); }
+	Ret visitBlock(Block *n){ return self().visitNode(n); }
+	Ret visitStatement(StatementAST *n){ return self().visitNode(n); }
+
+private:
+	Derived &self(){ return *static_cast<Derived *>(this); }
+};
+
+// ast_walker - preorder walk over a whole tree. Derived::pre runs before a
+// node's children and can return false to skip them; Derived::post runs
+// after them.
+template <class Derived>
+class ast_walker{
+
+public:
+	void walk(decafAST *n){
+		if(!self().pre(n))
+			return;
+		for_each_child(n, [this](decafAST *c){ walk(c); });
+		self().post(n);
+	}
+
+	bool pre(decafAST *n){ return true; }
+	void post(decafAST *n){}
+
+private:
+	Derived &self(){ return *static_cast<Derived *>(this); }
+};
+
+// node_counter - counts the nodes of a tree by kind
+class node_counter : public ast_walker<node_counter>{
+
+public:
+	node_counter() : total(0) { memset(counts, 0, sizeof(counts)); }
+
+	bool pre(decafAST *n){
+		counts[n->getKind()]++;
+		total++;
+		return true;
+	}
+
+	size_t total;
+	size_t counts[LastNodeKind + 1];
+};
@@ -0,0 +1,235 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <sys/stat.h>
+
+using namespace std;
+
+// module_digest - hashes of the parts of a program that codegen depends on.
+// Method bodies and field declarations are hashed one by one; everything
+// else (externs, the package name, method headers, comments between
+// declarations) goes into the single interface hash.
+struct module_digest {
+	unsigned int interface_hash;
+	vector<unsigned int> methods;
+	vector<unsigned int> fields;
+	vector<atom> field_names;
+};
+
+// the declarations of a program in the order codegen visits them
+struct module_decls {
+	vector<ExternAST *> externs;
+	vector<FieldDeclAST *> fields;
+	vector<MethodDecl *> methods;
+
+	module_decls(ProgramAST *prog){
+		for(auto e : prog->getExterns()->getList())
+			externs.push_back(llvm::cast<ExternAST>(e));
+		PackageAST *pkg = prog->getPackage();
+		for(auto f : pkg->getFields()->getList()){
+			decafStmtList *group = llvm::dyn_cast<decafStmtList>(f);
+			if(group == NULL){
+				fields.push_back(llvm::cast<FieldDeclAST>(f));
+				continue;
+			}
+			for(auto g : group->getList())
+				fields.push_back(llvm::cast<FieldDeclAST>(g));
+		}
+		for(auto m : pkg->getMethods()->getList())
+			methods.push_back(llvm::cast<MethodDecl>(m));
+	}
+};
+
+static module_digest digest_program(source_file &src, module_decls &decls){
+	module_digest d;
+	const char *text = src.data();
+	unsigned int h = fnv1a(NULL, 0);
+	int pos = 0;
+	// hash the gaps between holes; fields sharing one "var a, b int;" share
+	// a range, so only the first of them opens a hole
+	auto hole = [&](source_range r){
+		if(r.offset < pos)
+			return;
+		h = fnv1a(text + pos, r.offset - pos, h);
+		h = fnv1a("", 1, h);
+		pos = r.offset + r.length;
+	};
+	for(auto f : decls.fields){
+		source_range r = f->getRange();
+		d.fields.push_back(fnv1a(text + r.offset, r.length));
+		d.field_names.push_back(f->getName());
+		hole(r);
+	}
+	for(auto m : decls.methods){
+		source_range r = m->getBodyRange();
+		d.methods.push_back(fnv1a(text + r.offset, r.length));
+		hole(r);
+	}
+	d.interface_hash = fnv1a(text + pos, src.size() - pos, h);
+	return d;
+}
+
+// incremental_compiler - keeps a module in step with one source file.
+// Each update reparses the file, then regenerates only the method bodies
+// and fields whose text changed; anything that changes the interface
+// (signatures, externs, which fields exist) rebuilds the whole module.
+// Both go through the same passes as a normal compile with opts, so each
+// update prints what that compile would. With -O<n> every update is a
+// rebuild: inlining and constant propagation carry one function's body
+// into others, which a patch would leave stale.
+class incremental_compiler {
+public:
+	incremental_compiler(const char *p, const compile_options &o) : path(p), opts(o), pool(o.jobs), cx(context, "Test"), prog(NULL), stale(true) {
+		configure_codegen(cx, opts);
+	}
+
+	void update(){
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		source_file src;
+		parse_state ps;
+		ps.fast_scan = opts.fast_scan;
+		try {
+			src.open(path.c_str());
+		}
+		catch (std::runtime_error &e) {
+			cerr << "error: " << e.what() << endl;
+			return;
+		}
+		if(parse_decaf(src, &ps) != 0 || ps.prog == NULL){
+			cerr << "; parse failed, keeping the previous module" << endl;
+			return;
+		}
+		ProgramAST *next = ps.prog;
+		module_decls decls(next);
+		module_digest d = digest_program(src, decls);
+
+		vector<llvm::GlobalValue *> changed;
+		bool full = stale || opts.opt_level > 0 || d.interface_hash != current.interface_hash
+			|| d.methods.size() != current.methods.size() || d.field_names != current.field_names;
+		try {
+			if(!prepare_program(next, ps.nodes, pool, opts)){
+				stale = true;
+				return;
+			}
+			if(full || !patch(next, decls, d, changed)){
+				rebuild(next);
+				full = true;
+			}
+		}
+		catch (std::runtime_error &e) {
+			cout << "semantic error: " << e.what() << endl;
+			stale = true;
+			return;
+		}
+		// the previous tree goes away with ps
+		nodes.swap(ps.nodes);
+		prog = next;
+		current = d;
+		stale = false;
+
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		if(full){
+			cx.TheModule->dump();
+			cerr << "; rebuilt " << decls.methods.size() << " functions in " << ms << " ms" << endl;
+		}else{
+			for(auto v : changed)
+				v->dump();
+			cerr << "; regenerated " << changed.size() << " of " << decls.methods.size() + decls.fields.size()
+				<< " declarations in " << ms << " ms" << endl;
+		}
+	}
+
+private:
+	void rebuild(ProgramAST *next){
+		cx.reset("Test");
+		generate_program(next, pool, cx, opts);
+	}
+
+	// regenerate what changed in place, pointing the unchanged declarations
+	// of the new tree at what the previous tree generated; returns false if
+	// a field changed type and the module has to be rebuilt instead
+	bool patch(ProgramAST *next, module_decls &decls, module_digest &d, vector<llvm::GlobalValue *> &changed){
+		module_decls old(prog);
+		// the previous tree is about to be freed, so drop its entries
+		llvm::DenseMap<decafAST *, llvm::Value *> moved;
+		for(size_t i = 0; i < decls.externs.size(); i++)
+			moved[decls.externs[i]] = cx.decls.lookup(old.externs[i]);
+		for(size_t i = 0; i < decls.fields.size(); i++)
+			moved[decls.fields[i]] = cx.decls.lookup(old.fields[i]);
+		for(size_t i = 0; i < decls.methods.size(); i++)
+			moved[decls.methods[i]] = cx.decls.lookup(old.methods[i]);
+		cx.decls.swap(moved);
+
+		for(size_t i = 0; i < decls.fields.size(); i++){
+			FieldDeclAST *f = decls.fields[i];
+			if(d.fields[i] == current.fields[i])
+				continue;
+			llvm::GlobalVariable *prev = (llvm::GlobalVariable *) cx.decls.lookup(f);
+			llvm::GlobalVariable *gv = (llvm::GlobalVariable *) f->Codegen(cx);
+			if(gv->getType() != prev->getType())
+				return false;
+			prev->replaceAllUsesWith(gv);
+			gv->removeFromParent();
+			cx.TheModule->getGlobalList().insert(prev->getIterator(), gv);
+			prev->eraseFromParent();
+			gv->setName(atoms.spelling(f->getName()));
+			changed.push_back(gv);
+		}
+		for(size_t i = 0; i < decls.methods.size(); i++){
+			MethodDecl *m = decls.methods[i];
+			if(d.methods[i] == current.methods[i])
+				continue;
+			llvm::Function *func = llvm::cast<llvm::Function>(cx.decls.lookup(m));
+			func->deleteBody();
+			m->Codegen(cx);
+			changed.push_back(func);
+		}
+
+		// string constants used only by the bodies just replaced
+		for(auto i = cx.TheModule->global_begin(); i != cx.TheModule->global_end(); ){
+			llvm::GlobalVariable *gv = &*i++;
+			gv->removeDeadConstantUsers();
+			if(gv->hasPrivateLinkage() && gv->use_empty())
+				gv->eraseFromParent();
+		}
+		return true;
+	}
+
+	string path;
+	compile_options opts;
+	thread_pool pool;
+	llvm::LLVMContext context;
+	codegen_context cx;
+	ProgramAST *prog;
+	arena nodes;
+	module_digest current;
+	bool stale;
+};
+
+static bool same_stat(const struct stat &a, const struct stat &b){
+#ifdef __APPLE__
+	const struct timespec &ta = a.st_mtimespec, &tb = b.st_mtimespec;
+#else
+	const struct timespec &ta = a.st_mtim, &tb = b.st_mtim;
+#endif
+	return a.st_ino == b.st_ino && a.st_size == b.st_size
+		&& ta.tv_sec == tb.tv_sec && ta.tv_nsec == tb.tv_nsec;
+}
+
+// compile path as opts say, then recompile incrementally every time it
+// changes on disk
+int watch_source(const char *path, const compile_options &opts){
+	incremental_compiler compiler(path, opts);
+	struct stat last;
+	memset(&last, 0, sizeof(last));
+	for(;;){
+		struct stat st;
+		if(stat(path, &st) == 0 && !same_stat(st, last)){
+			last = st;
+			compiler.update();
+		}
+		this_thread::sleep_for(chrono::milliseconds(100));
+	}
+}
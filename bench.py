@@ -0,0 +1,494 @@
+"""
+First build the compiler in ./answer/
+
+Then run:
+
+    python bench.py scan
+
+to compare the flex scanner with the hand-written scanner on every
+testcase and on a large synthetic Decaf program, or
+
+    python bench.py stress
+
+to compile a single method with a million statements and report the
+time and peak memory it took, or
+
+    python bench.py alloc
+
+to compare the AST's heap allocations and peak memory with nodes allocated from
+the arena and allocated one by one, or
+
+    python bench.py walk
+
+to time whole-tree walks over the parsed AST with the printer and with
+the switch-based visitor, or
+
+    python bench.py codegen
+
+to time IR generation for expression-heavy programs (run either against
+an older build with -c to compare), or
+
+    python bench.py check
+
+to time the semantic checks over many methods on one thread and on one
+thread per core, or
+
+    python bench.py parallel-codegen
+
+to time IR generation on 1 to 32 threads and check that the module
+printed matches the serial build byte for byte at every -O level, or
+
+    python bench.py optimize
+
+to compile every testcase at -O0 to -O3 and report the time spent in
+codegen and in the pass pipeline, the instructions left, and how long
+the linked programs take to run, or
+
+    python bench.py ssa
+
+to make the same comparison between locals in stack slots and locals
+built straight into SSA form by -ssa, with and without -O1, or
+
+    python bench.py fold
+
+to compare expressions generated as written (-no-fold) with the
+constant folded AST, or
+
+    python bench.py bounds
+
+to compare array accesses with no index checks, a check on every
+access, and checks elided where a loop proves the index in range, on
+the testcases and on a program of array loops, with and without -O2, or
+
+    python bench.py run
+
+to time each testcase from source to output through llvm-as, llc, gcc
+and the linked binary, and in-process with -run, or
+
+    python bench.py object
+
+to time each testcase from source to a linked executable through the
+printed IR, llvm-as, llc and gcc, and through an object file written
+with -c.
+
+To customize the files used by default, run:
+
+    python bench.py -h
+"""
+
+import sys, os, optparse, subprocess, tempfile, time, resource, shutil
+import iocollect
+
+def synthetic_source(methods):
+    """A large, valid Decaf program heavy on identifiers, comments and whitespace."""
+    lines = ["extern func print_int(int) void;", "extern func print_string(string) void;", "", "package Synthetic {"]
+    for m in range(methods):
+        lines.append("    // method number {0} computes a running total of its argument list".format(m))
+        lines.append("    func compute_running_total_{0}(first_argument int, second_argument int) int {{".format(m))
+        lines.append("        var accumulated_value, loop_counter_variable int;")
+        lines.append("        accumulated_value = first_argument * 0x1F + second_argument % 10;")
+        lines.append("        for (loop_counter_variable = 0; loop_counter_variable < 100; loop_counter_variable = loop_counter_variable + 1) {")
+        lines.append("            accumulated_value = accumulated_value + loop_counter_variable << 2;          // shift it")
+        lines.append("        }")
+        lines.append("        print_string(\"accumulated value is \\n\");")
+        lines.append("        return(accumulated_value);")
+        lines.append("    }")
+    lines.append("    func main() int { return(0); }")
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+def long_method_source(statements):
+    """One method whose body is a single very long statement list."""
+    lines = ["package Stress {", "    func main() int {", "        var x int;"]
+    for i in range(statements):
+        lines.append("        x = x + {0};".format(i % 100))
+    lines.append("        return(x);")
+    lines.append("    }")
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+def expression_source(methods):
+    """Methods made of long arithmetic and comparison expressions."""
+    lines = ["package Expressions {"]
+    for m in range(methods):
+        lines.append("    func expressions_{0}(a int, b int, c int) bool {{".format(m))
+        lines.append("        var x, y int;")
+        lines.append("        var p, q bool;")
+        for i in range(20):
+            lines.append("        x = (a + b * {0} - c / 3) % 7 << 1 >> (b - {0});".format(i + 1))
+            lines.append("        y = -(x * x + a * b - c) / (x - {0}) + (a << 2);".format(i))
+            lines.append("        p = (x < y) == (a >= b) != !(c <= {0});".format(i))
+            lines.append("        q = (x == y) != (p == (a > c));")
+        lines.append("        return(p);")
+        lines.append("    }")
+    lines.append("    func main() int { return(0); }")
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+def array_loop_source(passes):
+    """Up, down and while loops over global arrays, with constant and variable bounds."""
+    lines = ["extern func print_int(int) void;", "package Arrays {", "    var a [1000]int;", "    var b [1000]int;"]
+    lines.append("    func up(n int) int {")
+    lines.append("        var i, s int;")
+    lines.append("        s = 0;")
+    lines.append("        for (i = 0; i < n; i = i + 1) { a[i] = a[i] + i; s = s + a[i] - b[i]; }")
+    lines.append("        return(s);")
+    lines.append("    }")
+    lines.append("    func down() int {")
+    lines.append("        var i, s int;")
+    lines.append("        s = 0;")
+    lines.append("        for (i = 999; i >= 0; i = i - 1) { b[i] = a[i] * 3; s = s + b[i]; }")
+    lines.append("        return(s);")
+    lines.append("    }")
+    lines.append("    func scan(n int) int {")
+    lines.append("        var i, s int;")
+    lines.append("        i = 0;")
+    lines.append("        s = 0;")
+    lines.append("        while (i < n) { s = s + a[i] % 7; i = i + 1; }")
+    lines.append("        return(s);")
+    lines.append("    }")
+    lines.append("    func main() int {")
+    lines.append("        var p, s int;")
+    lines.append("        s = 0;")
+    lines.append("        for (p = 0; p < {0}; p = p + 1) {{ s = s + up(1000) + down() - scan(1000); }}".format(passes))
+    lines.append("        print_int(s);")
+    lines.append("        return(0);")
+    lines.append("    }")
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+def parse_times(output):
+    times = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0] in ('flex', 'fast'):
+            times[fields[0]] = float(fields[1].rstrip('s'))
+    return times
+
+def bench_scan_file(compiler, path, reps):
+    prog = subprocess.Popen([compiler, "-bench-scan={0}".format(reps), path], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    (out, err) = prog.communicate()
+    if err:
+        sys.stderr.write(err)
+    return parse_times(out), os.path.getsize(path) * reps
+
+def report(name, nbytes, times):
+    mb = nbytes / (1024.0 * 1024.0)
+    flex, fast = times.get('flex', 0.0), times.get('fast', 0.0)
+    print "{0:<24} {1:>10.2f} MB  flex {2:8.1f} MB/s  fast {3:8.1f} MB/s  speedup {4:5.2f}x".format(
+        name, mb, mb / flex if flex else 0, mb / fast if fast else 0, flex / fast if fast else 0)
+
+def bench_scan(opts):
+    totals, total_bytes = {'flex': 0.0, 'fast': 0.0}, 0
+    for subdir in iocollect.getdirs(os.path.abspath(opts.testcase_dir)):
+        path = os.path.join(opts.testcase_dir, subdir)
+        for filename in iocollect.getfiles(os.path.abspath(path)):
+            if filename.endswith(opts.file_suffix):
+                times, nbytes = bench_scan_file(opts.compiler, os.path.join(path, filename), opts.reps)
+                for k in totals:
+                    totals[k] += times.get(k, 0.0)
+                total_bytes += nbytes
+    report("testcases", total_bytes, totals)
+
+    for methods in (1000, 10000, 100000):
+        (fd, path) = tempfile.mkstemp(suffix=opts.file_suffix)
+        try:
+            with os.fdopen(fd, 'w') as f:
+                f.write(synthetic_source(methods))
+            times, nbytes = bench_scan_file(opts.compiler, path, max(1, opts.reps / 100))
+            report("synthetic-{0}".format(methods), nbytes, times)
+        finally:
+            os.remove(path)
+
+def bench_stress(opts):
+    for statements in (10000, 100000, 1000000):
+        (fd, path) = tempfile.mkstemp(suffix=opts.file_suffix)
+        try:
+            with os.fdopen(fd, 'w') as f:
+                f.write(long_method_source(statements))
+            with open(os.devnull, 'w') as devnull:
+                start = time.time()
+                rc = subprocess.call([opts.compiler, path], stdout=devnull, stderr=devnull)
+                elapsed = time.time() - start
+            # ru_maxrss is in kilobytes and covers the largest child so far,
+            # which is always the run that just finished since sizes increase
+            peak = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss / 1024.0
+            print "statements-{0:<10} {1:>8.2f}s  peak rss {2:8.1f} MB  {3}".format(
+                statements, elapsed, peak, "ok" if rc == 0 else "FAILED (exit {0})".format(rc))
+        finally:
+            os.remove(path)
+
+def parse_stats(output):
+    stats = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if line.startswith("heap allocations"):
+            stats['allocs'] = int(fields[2])
+        elif line.startswith("peak rss"):
+            stats['rss'] = int(fields[2]) / 1024.0
+        elif line.startswith("ast nodes"):
+            stats['nodes'] = int(fields[2])
+    return stats
+
+def bench_alloc(opts):
+    for methods in (1000, 10000, 100000):
+        (fd, path) = tempfile.mkstemp(suffix=opts.file_suffix)
+        try:
+            with os.fdopen(fd, 'w') as f:
+                f.write(synthetic_source(methods))
+            for (name, flags) in (("arena", []), ("heap", ["-heap-ast"])):
+                with open(os.devnull, 'w') as devnull:
+                    prog = subprocess.Popen([opts.compiler, "-stats"] + flags + [path], stdout=subprocess.PIPE, stderr=devnull)
+                    (out, err) = prog.communicate()
+                stats = parse_stats(out)
+                print "synthetic-{0:<8} {1:<6} {2:>9} nodes  {3:>10} allocations  peak rss {4:8.1f} MB".format(
+                    methods, name, stats.get('nodes', 0), stats.get('allocs', 0), stats.get('rss', 0.0))
+        finally:
+            os.remove(path)
+
+def bench_walk(opts):
+    for methods in (10, 100, 1000):
+        (fd, path) = tempfile.mkstemp(suffix=opts.file_suffix)
+        try:
+            with os.fdopen(fd, 'w') as f:
+                f.write(synthetic_source(methods))
+            reps = max(1, opts.reps * 10 / methods)
+            for flag in ("-bench-walk", "-bench-visit"):
+                prog = subprocess.Popen([opts.compiler, "{0}={1}".format(flag, reps), path], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+                (out, err) = prog.communicate()
+                for line in out.splitlines():
+                    if line.startswith("walk") or line.startswith("visit"):
+                        print "synthetic-{0:<8} reps {1:<6} {2}".format(methods, reps, line)
+        finally:
+            os.remove(path)
+
+def bench_codegen(opts):
+    for methods in (10, 100, 1000):
+        (fd, path) = tempfile.mkstemp(suffix=opts.file_suffix)
+        try:
+            with os.fdopen(fd, 'w') as f:
+                f.write(expression_source(methods))
+            reps = max(1, opts.reps / methods)
+            prog = subprocess.Popen([opts.compiler, "-bench-codegen={0}".format(reps), path], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+            (out, err) = prog.communicate()
+            for line in out.splitlines():
+                if line.startswith("codegen") or line.startswith("semantic error"):
+                    print "expressions-{0:<8} reps {1:<6} {2}".format(methods, reps, line)
+        finally:
+            os.remove(path)
+
+def bench_check(opts):
+    for methods in (100, 1000, 10000):
+        (fd, path) = tempfile.mkstemp(suffix=opts.file_suffix)
+        try:
+            with os.fdopen(fd, 'w') as f:
+                f.write(expression_source(methods))
+            reps = max(1, opts.reps / methods)
+            for jobs in ("1", "0"):
+                prog = subprocess.Popen([opts.compiler, "-jobs=" + jobs, "-bench-check={0}".format(reps), path], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+                (out, err) = prog.communicate()
+                size = ""
+                for line in out.splitlines():
+                    if line.startswith("reps"):
+                        size = "jobs " + line.split()[3]
+                    elif line.startswith("check") or line.startswith("semantic error"):
+                        print "expressions-{0:<8} reps {1:<6} {2:<8} {3}".format(methods, reps, size, line)
+        finally:
+            os.remove(path)
+
+def bench_parallel_codegen(opts):
+    for methods in (100, 1000, 10000):
+        (fd, path) = tempfile.mkstemp(suffix=opts.file_suffix)
+        try:
+            with os.fdopen(fd, 'w') as f:
+                f.write(expression_source(methods))
+            # the optimizer names what it creates after what codegen named,
+            # so compare the module printed at every -O level
+            levels = ["-O{0}".format(level) for level in range(4)]
+            serial = [subprocess.Popen([opts.compiler, level, path], stdout=subprocess.PIPE, stderr=subprocess.PIPE).communicate()[1] for level in levels]
+            reps = max(1, opts.reps / methods)
+            for jobs in (1, 2, 4, 8, 16, 32):
+                differs = []
+                for (level, expected) in zip(levels, serial):
+                    ir = subprocess.Popen([opts.compiler, level, "-jobs={0}".format(jobs), "-parallel-codegen", path], stdout=subprocess.PIPE, stderr=subprocess.PIPE).communicate()[1]
+                    if ir != expected:
+                        differs.append(level)
+                same = "DIFFERS " + ",".join(differs) if differs else "same"
+                prog = subprocess.Popen([opts.compiler, "-jobs={0}".format(jobs), "-parallel-codegen", "-bench-codegen={0}".format(reps), path], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+                (out, err) = prog.communicate()
+                for line in out.splitlines():
+                    if line.startswith("codegen") or line.startswith("semantic error"):
+                        print "expressions-{0:<8} reps {1:<6} jobs {2:<4} {3:<8} {4}".format(methods, reps, jobs, same, line)
+        finally:
+            os.remove(path)
+
+def testcase_paths(opts):
+    for subdir in sorted(iocollect.getdirs(os.path.abspath(opts.testcase_dir))):
+        path = os.path.join(opts.testcase_dir, subdir)
+        for filename in sorted(iocollect.getfiles(os.path.abspath(path))):
+            if filename.endswith(opts.file_suffix):
+                yield os.path.join(path, filename)
+
+def build_executable(ir, workdir, stdlib):
+    """Assemble and link the IR the compiler printed, as llvm-run does; returns the binary or None."""
+    bindir = subprocess.check_output([os.environ.get('LLVMCONFIG') or 'llvm-config-3.8', "--bindir"]).strip()
+    ll, bc, asm, exe = [os.path.join(workdir, "prog" + ext) for ext in (".ll", ".bc", ".s", "")]
+    with open(ll, 'w') as f:
+        f.write(ir)
+    with open(os.devnull, 'w') as devnull:
+        for cmd in ([os.path.join(bindir, "llvm-as"), ll, "-o", bc], [os.path.join(bindir, "llc"), bc, "-o", asm], ["gcc", "-o", exe, asm, stdlib]):
+            if subprocess.call(cmd, stdout=devnull, stderr=devnull) != 0:
+                return None
+    return exe
+
+def time_run(exe, inpath, reps):
+    with open(os.devnull, 'w') as devnull:
+        start = time.time()
+        for i in range(reps):
+            infile = open(inpath) if os.path.exists(inpath) else None
+            subprocess.call([exe], stdin=infile, stdout=devnull, stderr=devnull)
+            if infile is not None:
+                infile.close()
+        return (time.time() - start) / reps
+
+def compare_builds(opts, builds, paths=None):
+    """Compile every testcase, or every program in paths, with each (name, flags) build, link and run it; report per build."""
+    stdlib = os.path.join(os.path.dirname(opts.compiler), "decaf-stdlib.c")
+    reps = max(1, opts.reps / 100)
+    totals = [{'codegen': 0.0, 'optimize': 0.0, 'instructions': 0, 'run': 0.0} for b in builds]
+    workdir = tempfile.mkdtemp()
+    try:
+        for path in paths if paths is not None else testcase_paths(opts):
+            # only programs that compile and link in every build are counted
+            results = []
+            for (name, flags) in builds:
+                (out, ir) = subprocess.Popen([opts.compiler] + flags + [path], stdout=subprocess.PIPE, stderr=subprocess.PIPE).communicate()
+                exe = build_executable(ir, workdir, stdlib) if ir.startswith("; ModuleID") else None
+                if exe is None:
+                    break
+                result = {'codegen': 0.0, 'optimize': 0.0, 'instructions': 0}
+                (out, err) = subprocess.Popen([opts.compiler] + flags + ["-bench-codegen={0}".format(reps), path], stdout=subprocess.PIPE, stderr=subprocess.PIPE).communicate()
+                for line in out.splitlines():
+                    fields = line.split()
+                    if line.startswith("reps"):
+                        result['instructions'] = int(fields[5])
+                    elif line.startswith("codegen"):
+                        result['codegen'] = float(fields[2]) / 1e3
+                    elif line.startswith("optimize"):
+                        result['optimize'] = float(fields[3]) / 1e3
+                result['run'] = time_run(exe, path[:-len(opts.file_suffix)] + ".in", 5)
+                results.append(result)
+            if len(results) < len(builds):
+                continue
+            for (i, (name, flags)) in enumerate(builds):
+                for k in totals[i]:
+                    totals[i][k] += results[i][k]
+                print "{0:<28} {1:<8} codegen {2:8.3f} ms  optimize {3:8.3f} ms  {4:>6} instructions  run {5:8.2f} ms".format(
+                    path, name, results[i]['codegen'] * 1e3, results[i]['optimize'] * 1e3, results[i]['instructions'], results[i]['run'] * 1e3)
+    finally:
+        shutil.rmtree(workdir)
+    base = totals[0]
+    for (i, (name, flags)) in enumerate(builds):
+        t = totals[i]
+        print "total {0:<8} codegen {1:8.2f} ms  optimize {2:8.2f} ms  {3:>8} instructions  run {4:8.2f} ms  speedup {5:5.2f}x".format(
+            name, t['codegen'] * 1e3, t['optimize'] * 1e3, t['instructions'], t['run'] * 1e3, base['run'] / t['run'] if t['run'] else 0)
+
+def bench_optimize(opts):
+    compare_builds(opts, [("-O{0}".format(level), ["-O{0}".format(level)]) for level in range(4)])
+
+def bench_ssa(opts):
+    compare_builds(opts, [("slots", []), ("ssa", ["-ssa"]), ("slots-O1", ["-O1"]), ("ssa-O1", ["-ssa", "-O1"])])
+
+def bench_fold(opts):
+    compare_builds(opts, [("no-fold", ["-no-fold"]), ("fold", []), ("no-fold-O1", ["-no-fold", "-O1"]), ("fold-O1", ["-O1"])])
+
+def bench_bounds(opts):
+    (fd, path) = tempfile.mkstemp(suffix=opts.file_suffix)
+    try:
+        with os.fdopen(fd, 'w') as f:
+            f.write(array_loop_source(2000))
+        builds = [(mode, ["-bounds-check=" + mode]) for mode in ("off", "always", "elide")]
+        compare_builds(opts, builds + [(name + "-O2", flags + ["-O2"]) for (name, flags) in builds], list(testcase_paths(opts)) + [path])
+    finally:
+        os.remove(path)
+
+def bench_run(opts):
+    stdlib = os.path.join(os.path.dirname(opts.compiler), "decaf-stdlib.c")
+    reps = max(1, opts.reps / 100)
+    totals = {'pipeline': 0.0, 'run': 0.0}
+    workdir = tempfile.mkdtemp()
+    try:
+        with open(os.devnull, 'w') as devnull:
+            for path in testcase_paths(opts):
+                inpath = path[:-len(opts.file_suffix)] + ".in"
+                times = {'pipeline': 0.0, 'run': 0.0}
+                for i in range(reps):
+                    start = time.time()
+                    (out, ir) = subprocess.Popen([opts.compiler, path], stdout=subprocess.PIPE, stderr=subprocess.PIPE).communicate()
+                    exe = build_executable(ir, workdir, stdlib) if ir.startswith("; ModuleID") else None
+                    if exe is None:
+                        break
+                    infile = open(inpath) if os.path.exists(inpath) else None
+                    subprocess.call([exe], stdin=infile, stdout=devnull, stderr=devnull)
+                    times['pipeline'] += time.time() - start
+                    if infile is not None:
+                        infile.seek(0)
+                    start = time.time()
+                    subprocess.call([opts.compiler, "-run", path], stdin=infile, stdout=devnull, stderr=devnull)
+                    times['run'] += time.time() - start
+                    if infile is not None:
+                        infile.close()
+                else:
+                    for k in totals:
+                        totals[k] += times[k] / reps
+                    print "{0:<28} pipeline {1:8.2f} ms  run {2:8.2f} ms".format(path, times['pipeline'] / reps * 1e3, times['run'] / reps * 1e3)
+    finally:
+        shutil.rmtree(workdir)
+    print "total pipeline {0:8.2f} ms  run {1:8.2f} ms  speedup {2:5.2f}x".format(
+        totals['pipeline'] * 1e3, totals['run'] * 1e3, totals['pipeline'] / totals['run'] if totals['run'] else 0)
+
+def bench_object(opts):
+    stdlib = os.path.join(os.path.dirname(opts.compiler), "decaf-stdlib.c")
+    reps = max(1, opts.reps / 100)
+    totals = {'ir': 0.0, 'object': 0.0}
+    workdir = tempfile.mkdtemp()
+    obj, exe = os.path.join(workdir, "prog.o"), os.path.join(workdir, "prog")
+    try:
+        with open(os.devnull, 'w') as devnull:
+            for path in testcase_paths(opts):
+                times = {'ir': 0.0, 'object': 0.0}
+                for i in range(reps):
+                    start = time.time()
+                    (out, ir) = subprocess.Popen([opts.compiler, path], stdout=subprocess.PIPE, stderr=subprocess.PIPE).communicate()
+                    if not ir.startswith("; ModuleID") or build_executable(ir, workdir, stdlib) is None:
+                        break
+                    times['ir'] += time.time() - start
+                    start = time.time()
+                    if subprocess.call([opts.compiler, "-c", "-o", obj, path], stdout=devnull, stderr=devnull) != 0:
+                        break
+                    if subprocess.call(["gcc", "-o", exe, obj, stdlib], stdout=devnull, stderr=devnull) != 0:
+                        break
+                    times['object'] += time.time() - start
+                else:
+                    for k in totals:
+                        totals[k] += times[k] / reps
+                    print "{0:<28} ir {1:8.2f} ms  object {2:8.2f} ms".format(path, times['ir'] / reps * 1e3, times['object'] / reps * 1e3)
+    finally:
+        shutil.rmtree(workdir)
+    print "total ir {0:8.2f} ms  object {1:8.2f} ms  saved {2:8.2f} ms".format(
+        totals['ir'] * 1e3, totals['object'] * 1e3, (totals['ir'] - totals['object']) * 1e3)
+
+modes = { 'scan': bench_scan, 'stress': bench_stress, 'alloc': bench_alloc, 'walk': bench_walk, 'codegen': bench_codegen, 'check': bench_check, 'parallel-codegen': bench_parallel_codegen, 'optimize': bench_optimize, 'ssa': bench_ssa, 'fold': bench_fold, 'bounds': bench_bounds, 'run': bench_run, 'object': bench_object }
+
+if __name__ == '__main__':
+    optparser = optparse.OptionParser(usage="%prog [options] " + "|".join(sorted(modes)))
+    optparser.add_option("-c", "--compiler", dest="compiler", default=os.path.join('answer', 'decafcomp'), help="compiler binary [default: answer/decafcomp]")
+    optparser.add_option("-t", "--testcases", dest="testcase_dir", default='testcases', help="testcases directory [default: testcases]")
+    optparser.add_option("-e", "--ending", dest="file_suffix", default='.decaf', help="suffix to use for testcases [default: .decaf]")
+    optparser.add_option("-n", "--reps", dest="reps", type="int", default=1000, help="repetitions per testcase [default: 1000]")
+    (opts, args) = optparser.parse_args()
+
+    if len(args) != 1 or args[0] not in modes:
+        optparser.print_help()
+        sys.exit(2)
+    modes[args[0]](opts)